@@ -66,17 +66,28 @@ void Bat::drawLine()
 
 void Bat::update(World & world, Player& player)
 {
+	move(world, player);
+	land(world.getHeight(m_cursor, m_position, RADIUS), player);
+}
+
+// the first half of update, up to the ground height query
+void Bat::move(World & world, Player& player)
+{
+	// a dead bat falls until its step meets the terrain
 	if (isDead()) {
-		float height = world.getHeight(m_position, RADIUS);
-		if (m_position.y > height) {
-			m_position += m_velocity * DeltaTime::FIXED_DELTA_TIME;
+		Vector3 step = m_velocity * DeltaTime::FIXED_DELTA_TIME;
+		float hit = world.raycast(m_position, step, 1.0f);
+		if (hit >= 0.0f) {
+			m_position += step * hit;
+			m_velocity = Vector3::ZERO;
+		}
+		else {
+			m_position += step;
 			m_velocity += Vector3(0.0, -9.8, 0.0) * DeltaTime::FIXED_DELTA_TIME;
 		}
-		else
-			m_position.y = height;
 		return;
 	}
-	
+
 	Vector3 target = player.getPosition();
 	if (m_position.getDistanceXZ(target) <= 20.0)
 		pursue(player);
@@ -87,7 +98,19 @@ void Bat::update(World & world, Player& player)
 	m_acceleration = direction.getNormalized() * MAX_ACCELERATION;
 
 	m_position += m_velocity * DeltaTime::FIXED_DELTA_TIME;
-	float height = world.getHeight(m_position, RADIUS);
+}
+
+// the second half of update, with the ground height under the
+// bat's current position
+void Bat::land(float height, Player& player)
+{
+	if (isDead()) {
+		if (m_position.y < height)
+			m_position.y = height;
+		return;
+	}
+
+	Vector3 target = player.getPosition();
 	if (m_position.y <= height) {
 		m_position.y = height;
 		m_acceleration.y = -m_acceleration.y;
@@ -108,11 +131,26 @@ bool Bat::isDead() const
 	return is_dead;
 }
 
+Vector3 Bat::getPosition() const
+{
+	return m_position;
+}
+
+World::Cursor& Bat::getCursor()
+{
+	return m_cursor;
+}
+
 ObjLibrary::Vector3 Bat::getHitVelocity()
 {
 	return hit_velocity;
 }
 
+float Bat::getRadius()
+{
+	return RADIUS;
+}
+
 void Bat::loadModel()
 {
 	assert(!isModelsLoaded());
@@ -18,8 +18,15 @@ public:
 	void draw();
 	void drawLine();
 	void update(World& world, Player& player);
+	// update() split in two so a caller can query the ground
+	// height for many bats in between
+	void move(World& world, Player& player);
+	void land(float height, Player& player);
 	bool isDead() const;
+	ObjLibrary::Vector3 getPosition() const;
+	World::Cursor& getCursor();
 	ObjLibrary::Vector3 getHitVelocity();
+	static float getRadius();
 
 private:
 	void loadModel();
@@ -36,6 +43,7 @@ private:
 	ObjLibrary::Vector3 m_acceleration;
 	ObjLibrary::Vector3 target_position;
 	ObjLibrary::Vector3 hit_velocity;
+	World::Cursor m_cursor;
 
 	bool is_dead;
 };
@@ -2,8 +2,10 @@
 //	Disk.cpp
 //
 
+#include <algorithm>
 #include "Disk.h"
 #include "DiskType.h"
+#include "HeightmapPool.h"
 #include "ObjLibrary/ObjModel.h"
 
 using namespace std;
@@ -12,18 +14,60 @@ namespace {
 	bool is_initialized = false;
 	ObjModel disk_model[DiskType::COUNT];
 	DisplayList disk_list[DiskType::COUNT];
+	// a terrain mesh is decimated while its triangles would still
+	// span less than this many meters per meter of distance from
+	// the camera
+	const float LOD_ERROR = 0.02f;
+	// a grey rock disk is split into tiles once a single heightmap
+	// would space its samples wider than this, in meters
+	const float MAX_SAMPLE_SPACING = 0.9f;
+
+	// the part of [t0, t1] in which the ray from (x, z) along
+	// (dx, dz) is over the square from (x0, z0) to (x1, z1); false
+	// if there is none
+	bool clipToSquare(float x, float z, float dx, float dz,
+		float x0, float z0, float x1, float z1, float& t0, float& t1)
+	{
+		const float start[2] = { x, z };
+		const float speed[2] = { dx, dz };
+		const float low[2] = { x0, z0 };
+		const float high[2] = { x1, z1 };
+		for (int axis = 0; axis < 2; axis++) {
+			if (speed[axis] == 0.0f) {
+				if (start[axis] < low[axis] || start[axis] > high[axis])
+					return false;
+				continue;
+			}
+			float enter = (low[axis] - start[axis]) / speed[axis];
+			float leave = (high[axis] - start[axis]) / speed[axis];
+			if (enter > leave)
+				swap(enter, leave);
+			t0 = max(t0, enter);
+			t1 = min(t1, leave);
+		}
+		return t0 <= t1;
+	}
 }
 
-Disk::Disk() : m_position() {}
+Disk::Disk() : m_position(), m_tile_columns(1) {}
 
-Disk::Disk(Vector3 position, float radius) 
+Disk::Disk(Vector3 position, float radius, uint64_t seed, const HeightmapPool* pool)
 	: m_position(position)
 	, m_radius(radius)
 	, m_diskType(calculateDiskType(radius))
-	, m_heightmap(m_diskType)
-{}
+	, m_tile_columns(calculateTileColumns(radius, m_diskType))
+{
+	if (m_tile_columns == 1)
+		m_tiles.push_back(pool != nullptr ? pool->get(m_diskType, seed)
+			: make_shared<Heightmap>(m_diskType, seed));
+	else
+		for (int row = 0; row < m_tile_columns; row++)
+			for (int column = 0; column < m_tile_columns; column++)
+				m_tiles.push_back(make_shared<Heightmap>(m_diskType, seed,
+					column, row, m_tile_columns));
+}
 
-void Disk::draw()
+void Disk::drawModel()
 {
 	if (!is_initialized) {
 		// sign all disk objects to the display list
@@ -39,15 +83,62 @@ void Disk::draw()
 	glScalef(m_radius, 1.0f, m_radius);
 	disk_list[m_diskType].draw();
 	glPopMatrix();
+}
 
+// each tile picks its own detail from its distance to the camera
+void Disk::drawTerrain(bool can_build, const Vector3& camera)
+{
 	float length = m_radius * (float)sqrt(2);
-	float scaling = length / DiskType::getSideLength(m_diskType);
+	float scaling = length / getSideLength();
+	float tile_length = length / m_tile_columns;
 
-	glPushMatrix();
-	glTranslated(length*(-0.5) + m_position.x, 0.0, length*(-0.5) + m_position.z);
-	glScalef(scaling, 1.0, scaling);
-	m_heightmap.draw();
-	glPopMatrix();
+	for (int row = 0; row < m_tile_columns; row++)
+		for (int column = 0; column < m_tile_columns; column++) {
+			double x0 = length*(-0.5) + m_position.x + column * tile_length;
+			double z0 = length*(-0.5) + m_position.z + row * tile_length;
+
+			// the distance from the camera to the nearest point of
+			// the disk, or of the tile if there are several
+			double edge_distance;
+			if (m_tile_columns == 1)
+				edge_distance = max(camera.getDistanceXZ(m_position) - m_radius, 0.0);
+			else {
+				double dx = max(max(x0 - camera.x, camera.x - (x0 + tile_length)), 0.0);
+				double dz = max(max(z0 - camera.z, camera.z - (z0 + tile_length)), 0.0);
+				edge_distance = sqrt(dx * dx + dz * dz);
+			}
+			float distance = (float)sqrt(edge_distance * edge_distance + camera.y * camera.y);
+			unsigned int level = 0;
+			while (level + 1 < Heightmap::LOD_COUNT &&
+				(2 << level) * scaling <= distance * LOD_ERROR)
+				level++;
+
+			glPushMatrix();
+			glTranslated(x0, 0.0, z0);
+			glScalef(scaling, 1.0, scaling);
+			m_tiles[row * m_tile_columns + column]->draw(can_build, level);
+			glPopMatrix();
+		}
+}
+
+void Disk::findTiles(const Vector3& position, float reach, vector<unsigned int>& tiles) const
+{
+	if (m_tile_columns == 1) {
+		tiles.push_back(0);
+		return;
+	}
+
+	float length = m_radius * (float)sqrt(2);
+	float tile_length = length / m_tile_columns;
+	for (int row = 0; row < m_tile_columns; row++)
+		for (int column = 0; column < m_tile_columns; column++) {
+			double x0 = length*(-0.5) + m_position.x + column * tile_length;
+			double z0 = length*(-0.5) + m_position.z + row * tile_length;
+			double dx = max(max(x0 - position.x, position.x - (x0 + tile_length)), 0.0);
+			double dz = max(max(z0 - position.z, position.z - (z0 + tile_length)), 0.0);
+			if (dx * dx + dz * dz <= reach * reach)
+				tiles.push_back(row * m_tile_columns + column);
+		}
 }
 
 int Disk::calculateDiskType(float radius)
@@ -60,10 +151,36 @@ int Disk::calculateDiskType(float radius)
 		return DiskType::ICY;
 	else if (m_radius < 30.0f)
 		return DiskType::SANDY;
-	else if (m_radius < 50.0f)
-		return DiskType::GREY_ROCK;
 	else
-		exit(1);
+		return DiskType::GREY_ROCK;
+}
+
+// only the grey rock terrain is generated in a way that can be split
+int Disk::calculateTileColumns(float radius, int disk_type)
+{
+	if (disk_type != DiskType::GREY_ROCK)
+		return 1;
+	float spacing = radius * (float)sqrt(2) / DiskType::getSideLength(disk_type);
+	return max((int)ceil(spacing / MAX_SAMPLE_SPACING), 1);
+}
+
+float Disk::getSideLength() const
+{
+	return (float)(DiskType::getSideLength(m_diskType) * m_tile_columns);
+}
+
+const Heightmap* Disk::findTile(float& x, float& z) const
+{
+	float tile_side = (float)DiskType::getSideLength(m_diskType);
+	if (!(x >= 0.0f && z >= 0.0f))
+		return nullptr;
+	int column = (int)(x / tile_side);
+	int row = (int)(z / tile_side);
+	if (column >= m_tile_columns || row >= m_tile_columns)
+		return nullptr;
+	x -= column * tile_side;
+	z -= row * tile_side;
+	return m_tiles[row * m_tile_columns + column].get();
 }
 
 // add the new function for Assignment 3
@@ -80,7 +197,191 @@ float Disk::getHeight(Vector3 position) const
 	else {
 		Vector3 p1 = pd + Vector3(HALF_SQRT2, 0.0, HALF_SQRT2);
 		Vector3 p2 = p1 / SQRT2;
-		Vector3 ph = p2 * DiskType::getSideLength(m_diskType);
-		return m_heightmap.getHeight((float)ph.x, (float)ph.z);
+		Vector3 ph = p2 * getSideLength();
+		float x = (float)ph.x;
+		float z = (float)ph.z;
+		const Heightmap* tile = findTile(x, z);
+		if (tile == nullptr)
+			return 0.0f;
+		return tile->getHeight(x, z);
+	}
+}
+
+// the same transform as getHeight; the heightmap is stretched by
+// the same factor in x and z, so its gradient only needs scaling
+Vector3 Disk::getSlope(Vector3 position) const
+{
+	float side_length = getSideLength();
+	float scaling = side_length / (m_radius * (float)sqrt(2));
+	float x = (float)(position.x - m_position.x) * scaling + 0.5f * side_length;
+	float z = (float)(position.z - m_position.z) * scaling + 0.5f * side_length;
+	const Heightmap* tile = findTile(x, z);
+	if (tile == nullptr)
+		return Vector3::ZERO;
+
+	float gradient_x, gradient_z;
+	tile->getGradient(x, z, gradient_x, gradient_z);
+	return Vector3(gradient_x * scaling, 0.0, gradient_z * scaling);
+}
+
+// the heightmap takes the ray in its own coordinates, where t is the
+// same; around the heightmap square the disk is solid up to height
+// 0, and the ray is first inside that part where it has entered the
+// disk's cylinder and gone below 0, unless it is over the square
+// then, in which case it may still reach the rim where it leaves the
+// square
+float Disk::raycast(const Vector3& origin, const Vector3& direction, float max_t) const
+{
+	float side_length = getSideLength();
+	float scaling = side_length / (m_radius * (float)sqrt(2));
+	float x = (float)(origin.x - m_position.x) * scaling + 0.5f * side_length;
+	float z = (float)(origin.z - m_position.z) * scaling + 0.5f * side_length;
+	float dx = (float)direction.x * scaling;
+	float dz = (float)direction.z * scaling;
+	float hit = raycastTiles(x, (float)origin.y, z, dx, (float)direction.y, dz, max_t);
+	float t1 = (hit >= 0.0f) ? hit : max_t;
+
+	// the span of t inside the cylinder and below height 0
+	float t0 = 0.0f;
+	float rx = (float)(origin.x - m_position.x);
+	float rz = (float)(origin.z - m_position.z);
+	float a = (float)(direction.x * direction.x + direction.z * direction.z);
+	float b = (float)(rx * direction.x + rz * direction.z);
+	float c = rx * rx + rz * rz - m_radius * m_radius;
+	if (a > 0.0f) {
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f)
+			return hit;
+		float root = sqrt(discriminant);
+		t0 = max(t0, (-b - root) / a);
+		t1 = min(t1, (-b + root) / a);
+	}
+	else if (c > 0.0f)
+		return hit;
+	if (direction.y < 0.0)
+		t0 = max(t0, (float)(-origin.y / direction.y));
+	else if (direction.y > 0.0)
+		t1 = min(t1, (float)(-origin.y / direction.y));
+	else if (origin.y >= 0.0)
+		return hit;
+	if (t0 > t1)
+		return hit;
+
+	// the part of that span over the square belongs to the heightmap
+	float square0 = t0;
+	float square1 = t1;
+	if (!clipToSquare(x, z, dx, dz, 0.0f, 0.0f, side_length, side_length, square0, square1) ||
+		square0 > t0)
+		return t0;
+	if (square1 < t1)
+		return square1;
+	return hit;
+}
+
+// the tiles the ray passes over are walked in the order it reaches
+// them, one grid line at a time, so the first hit is the nearest
+float Disk::raycastTiles(float x, float y, float z, float dx, float dy, float dz,
+	float max_t) const
+{
+	if (m_tile_columns == 1)
+		return m_tiles[0]->raycast(x, y, z, dx, dy, dz, max_t);
+
+	float side_length = getSideLength();
+	float t0 = 0.0f;
+	float t1 = max_t;
+	if (!clipToSquare(x, z, dx, dz, 0.0f, 0.0f, side_length, side_length, t0, t1))
+		return -1.0f;
+
+	// the tiles under the ends of the part over the square
+	float tile_side = (float)DiskType::getSideLength(m_diskType);
+	int last = m_tile_columns - 1;
+	int column = min(max((int)floor((x + dx * t0) / tile_side), 0), last);
+	int row = min(max((int)floor((z + dz * t0) / tile_side), 0), last);
+	int end_column = min(max((int)floor((x + dx * t1) / tile_side), 0), last);
+	int end_row = min(max((int)floor((z + dz * t1) / tile_side), 0), last);
+	if (column == end_column && row == end_row)
+		return m_tiles[row * m_tile_columns + column]->raycast(x - column * tile_side, y,
+			z - row * tile_side, dx, dy, dz, max_t);
+
+	// the t at which the ray crosses the next column and row line;
+	// along an axis it does not move in, that is past the end
+	int column_step = (dx > 0.0f) ? 1 : -1;
+	int row_step = (dz > 0.0f) ? 1 : -1;
+	float next_column_t = max_t;
+	float next_row_t = max_t;
+	float column_t_step = 0.0f;
+	float row_t_step = 0.0f;
+	if (dx != 0.0f) {
+		next_column_t = ((column + (dx > 0.0f ? 1 : 0)) * tile_side - x) / dx;
+		column_t_step = tile_side / abs(dx);
+	}
+	if (dz != 0.0f) {
+		next_row_t = ((row + (dz > 0.0f ? 1 : 0)) * tile_side - z) / dz;
+		row_t_step = tile_side / abs(dz);
+	}
+
+	while (true) {
+		float hit = m_tiles[row * m_tile_columns + column]->raycast(x - column * tile_side, y,
+			z - row * tile_side, dx, dy, dz, max_t);
+		if (hit >= 0.0f)
+			return hit;
+		if (min(next_column_t, next_row_t) >= t1)
+			return -1.0f;
+		if (next_column_t < next_row_t) {
+			column += column_step;
+			next_column_t += column_t_step;
+		}
+		else {
+			row += row_step;
+			next_row_t += row_t_step;
+		}
+		if (column < 0 || column > last || row < 0 || row > last)
+			return -1.0f;
+	}
+}
+
+// the batched version of getHeight: the transform to heightmap
+// coordinates is done in float and the heightmap interpolates a
+// whole chunk of points at once
+void Disk::getHeights(const Vector3 positions[], unsigned int count, float heights[]) const
+{
+	const unsigned int CHUNK_SIZE = 64;
+	float x[CHUNK_SIZE];
+	float z[CHUNK_SIZE];
+
+	float side_length = getSideLength();
+	float scaling = side_length / (m_radius * (float)sqrt(2));
+	float half_side = 0.5f * side_length;
+	for (unsigned int start = 0; start < count; start += CHUNK_SIZE) {
+		unsigned int chunk = min(CHUNK_SIZE, count - start);
+		for (unsigned int i = 0; i < chunk; i++) {
+			x[i] = (float)(positions[start + i].x - m_position.x) * scaling + half_side;
+			z[i] = (float)(positions[start + i].z - m_position.z) * scaling + half_side;
+		}
+		if (m_tile_columns == 1) {
+			m_tiles[0]->getHeights(x, z, chunk, heights + start);
+			continue;
+		}
+
+		// each run of points on the same tile goes to it in one batch
+		unsigned int i = 0;
+		while (i < chunk) {
+			const Heightmap* tile = findTile(x[i], z[i]);
+			unsigned int end = i + 1;
+			if (tile == nullptr)
+				heights[start + i] = 0.0f;
+			else {
+				for (; end < chunk; end++) {
+					float tile_x = x[end];
+					float tile_z = z[end];
+					if (findTile(tile_x, tile_z) != tile)
+						break;
+					x[end] = tile_x;
+					z[end] = tile_z;
+				}
+				tile->getHeights(x + i, z + i, end - i, heights + start + i);
+			}
+			i = end;
+		}
 	}
 }
\ No newline at end of file
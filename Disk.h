@@ -5,30 +5,76 @@
 #ifndef DISK_H
 #define DISK_H
 
+#include <memory>
+#include <vector>
 #include "Heightmap.h"
 #include "ObjLibrary/Vector3.h"
 
+class HeightmapPool;
+
+// a disk too big for one heightmap to keep the usual sample spacing
+// has its terrain split into square tiles, each a heightmap of its
+// own that is only built once something needs it
 class Disk {
 public:
 	/* constructors and destructor */
 	Disk();
-	Disk(ObjLibrary::Vector3 position, float radius);
+	// with a pool the disk uses one of its shared heightmaps, unless
+	// it needs tiles
+	Disk(ObjLibrary::Vector3 position, float radius, uint64_t seed,
+		const HeightmapPool* pool = nullptr);
 	~Disk() = default;
 
 	/* member functions */
-	void draw();
+	void drawModel();
+	// between Heightmap::beginDraw and endDraw for the disk's type;
+	// can_build: see Heightmap::draw; the terrain detail drops with
+	// the distance from the camera
+	void drawTerrain(bool can_build, const ObjLibrary::Vector3& camera);
 	ObjLibrary::Vector3 getPosition() const { return m_position; }
 	float getRadius() const { return m_radius; }
 	int getDiskType() const { return m_diskType; }
 	float getHeight(ObjLibrary::Vector3 position) const;
+	void getHeights(const ObjLibrary::Vector3 positions[], unsigned int count,
+		float heights[]) const;
+	// the uphill gradient of the terrain at position, in height per
+	// meter in x and z: its length is the slope, and the way down
+	// is against it (0 off the heightmap)
+	ObjLibrary::Vector3 getSlope(ObjLibrary::Vector3 position) const;
+	// the first t in [0, max_t] at which origin + t * direction is
+	// below the terrain or inside the solid disk around it (0 if
+	// origin is), or -1 if there is none
+	float raycast(const ObjLibrary::Vector3& origin, const ObjLibrary::Vector3& direction,
+		float max_t) const;
+	// copies of a disk (and of the world) share its heightmaps; tile
+	// (column, row) is number row * getTileColumns() + column
+	unsigned int getTileCount() const { return m_tiles.size(); }
+	int getTileColumns() const { return m_tile_columns; }
+	const std::shared_ptr<Heightmap>& getTile(unsigned int tile) const { return m_tiles[tile]; }
+	// adds the tiles with any point within reach of position in xz;
+	// a disk of one tile always adds it
+	void findTiles(const ObjLibrary::Vector3& position, float reach,
+		std::vector<unsigned int>& tiles) const;
 
 private:
 	int calculateDiskType(float radius);
+	// takes the disk type, so m_diskType must be declared (and so
+	// initialized) before m_tile_columns
+	static int calculateTileColumns(float radius, int disk_type);
+	// the side of the whole heightmap square, in samples
+	float getSideLength() const;
+	// the tile under heightmap point (x, z), which is moved into the
+	// tile's own coordinates, or null if the point is off the square
+	const Heightmap* findTile(float& x, float& z) const;
+	// Heightmap::raycast over the whole square, in its coordinates
+	float raycastTiles(float x, float y, float z, float dx, float dy, float dz,
+		float max_t) const;
 	/* member variables */
 	ObjLibrary::Vector3 m_position;
 	float m_radius;
 	int m_diskType;
-	Heightmap m_heightmap;
+	int m_tile_columns;
+	std::vector<std::shared_ptr<Heightmap>> m_tiles;
 };
 
 #endif
\ No newline at end of file
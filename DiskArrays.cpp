@@ -0,0 +1,163 @@
+//
+//	DiskArrays.cpp
+//
+
+#include <cmath>
+#include "DiskArrays.h"
+#include "Simd.h"
+
+using namespace std;
+
+void DiskArrays::clear()
+{
+	m_x.clear();
+	m_z.clear();
+	m_radius.clear();
+	m_disk_index.clear();
+}
+
+void DiskArrays::add(double x, double z, float radius, unsigned int disk_index)
+{
+	m_x.push_back(x);
+	m_z.push_back(z);
+	m_radius.push_back(radius);
+	m_disk_index.push_back(disk_index);
+}
+
+// the distances are computed with the same double operations as
+// Vector3::getDistanceXZ, so the vector and scalar loops agree
+// exactly with each other and with a scan over the Disk objects
+void DiskArrays::findClosest(unsigned int begin, unsigned int end,
+	double x, double z, int& best_disk, double& best_distance) const
+{
+	unsigned int i = begin;
+#ifdef USE_AVX2
+	if (begin + 4 <= end) {
+		const __m256d px = _mm256_set1_pd(x);
+		const __m256d pz = _mm256_set1_pd(z);
+		__m256d lane_distance = _mm256_set1_pd(HUGE_VAL);
+		__m256d lane_disk = _mm256_set1_pd(-1.0);
+		for (; i + 4 <= end; i += 4) {
+			__m256d dx = _mm256_sub_pd(px, _mm256_loadu_pd(&m_x[i]));
+			__m256d dz = _mm256_sub_pd(pz, _mm256_loadu_pd(&m_z[i]));
+			__m256d distance = _mm256_sub_pd(
+				_mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dz, dz))),
+				_mm256_cvtps_pd(_mm_loadu_ps(&m_radius[i])));
+			__m256d disk = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)&m_disk_index[i]));
+			__m256d better = _mm256_or_pd(_mm256_cmp_pd(distance, lane_distance, _CMP_LT_OQ),
+				_mm256_and_pd(_mm256_cmp_pd(distance, lane_distance, _CMP_EQ_OQ),
+					_mm256_cmp_pd(disk, lane_disk, _CMP_LT_OQ)));
+			lane_distance = _mm256_blendv_pd(lane_distance, distance, better);
+			lane_disk = _mm256_blendv_pd(lane_disk, disk, better);
+		}
+
+		double distances[4];
+		double disks[4];
+		_mm256_storeu_pd(distances, lane_distance);
+		_mm256_storeu_pd(disks, lane_disk);
+		for (int lane = 0; lane < 4; lane++) {
+			int disk = (int)disks[lane];
+			if (disk >= 0 && (best_disk < 0 || distances[lane] < best_distance ||
+				(distances[lane] == best_distance && disk < best_disk))) {
+				best_disk = disk;
+				best_distance = distances[lane];
+			}
+		}
+	}
+#endif
+	for (; i < end; i++) {
+		double dx = x - m_x[i];
+		double dz = z - m_z[i];
+		double distance = sqrt(dx * dx + dz * dz) - m_radius[i];
+		int disk = m_disk_index[i];
+		if (best_disk < 0 || distance < best_distance ||
+			(distance == best_distance && disk < best_disk)) {
+			best_disk = disk;
+			best_distance = distance;
+		}
+	}
+}
+
+void DiskArrays::findNumber(unsigned int begin, unsigned int end,
+	double x, double z, float query_radius, int& min_i, float& min_dist) const
+{
+	unsigned int i = begin;
+#ifdef USE_AVX2
+	if (begin + 4 <= end) {
+		const __m256d px = _mm256_set1_pd(x);
+		const __m256d pz = _mm256_set1_pd(z);
+		const __m128 reach = _mm_set1_ps(query_radius);
+		__m128 lane_dist = _mm_set1_ps(min_dist);
+		__m128i lane_i = _mm_set1_epi32(min_i);
+		for (; i + 4 <= end; i += 4) {
+			__m256d dx = _mm256_sub_pd(px, _mm256_loadu_pd(&m_x[i]));
+			__m256d dz = _mm256_sub_pd(pz, _mm256_loadu_pd(&m_z[i]));
+			__m128 h_distance = _mm256_cvtpd_ps(
+				_mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dz, dz))));
+			__m128i disk = _mm_loadu_si128((const __m128i*)&m_disk_index[i]);
+			__m128 inside = _mm_cmplt_ps(h_distance, _mm_add_ps(_mm_loadu_ps(&m_radius[i]), reach));
+			__m128 better = _mm_or_ps(_mm_cmplt_ps(h_distance, lane_dist),
+				_mm_and_ps(_mm_cmpeq_ps(h_distance, lane_dist),
+					_mm_castsi128_ps(_mm_cmplt_epi32(disk, lane_i))));
+			__m128 update = _mm_and_ps(inside, better);
+			lane_dist = _mm_blendv_ps(lane_dist, h_distance, update);
+			lane_i = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(lane_i),
+				_mm_castsi128_ps(disk), update));
+		}
+
+		float dists[4];
+		int disks[4];
+		_mm_storeu_ps(dists, lane_dist);
+		_mm_storeu_si128((__m128i*)disks, lane_i);
+		for (int lane = 0; lane < 4; lane++) {
+			if (disks[lane] >= 0 && (min_dist > dists[lane] ||
+				(min_dist == dists[lane] && disks[lane] < min_i))) {
+				min_dist = dists[lane];
+				min_i = disks[lane];
+			}
+		}
+	}
+#endif
+	for (; i < end; i++) {
+		double dx = x - m_x[i];
+		double dz = z - m_z[i];
+		float h_distance = (float)sqrt(dx * dx + dz * dz);
+		int disk = m_disk_index[i];
+		if (h_distance < m_radius[i] + query_radius &&
+			(min_dist > h_distance || (min_dist == h_distance && disk < min_i))) {
+			min_dist = h_distance;
+			min_i = disk;
+		}
+	}
+}
+
+void DiskArrays::findTouching(double x, double z, float radius,
+	unsigned int begin, unsigned int end, double slack, vector<unsigned int>& touching) const
+{
+	unsigned int i = begin;
+#ifdef USE_AVX2
+	const __m256d px = _mm256_set1_pd(x);
+	const __m256d pz = _mm256_set1_pd(z);
+	const __m128 radius4 = _mm_set1_ps(radius);
+	const __m256d slack4 = _mm256_set1_pd(slack);
+	for (; i + 4 <= end; i += 4) {
+		__m256d dx = _mm256_sub_pd(px, _mm256_loadu_pd(&m_x[i]));
+		__m256d dz = _mm256_sub_pd(pz, _mm256_loadu_pd(&m_z[i]));
+		__m256d distance = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dz, dz)));
+		// the radii are added in float before the slack, as in a scalar test
+		__m256d limit = _mm256_add_pd(
+			_mm256_cvtps_pd(_mm_add_ps(radius4, _mm_loadu_ps(&m_radius[i]))), slack4);
+		int mask = _mm256_movemask_pd(_mm256_cmp_pd(distance, limit, _CMP_LE_OQ));
+		for (int lane = 0; mask != 0; lane++, mask >>= 1)
+			if (mask & 1)
+				touching.push_back(m_disk_index[i + lane]);
+	}
+#endif
+	for (; i < end; i++) {
+		double dx = x - m_x[i];
+		double dz = z - m_z[i];
+		double distance = sqrt(dx * dx + dz * dz);
+		if (distance <= radius + m_radius[i] + slack)
+			touching.push_back(m_disk_index[i]);
+	}
+}
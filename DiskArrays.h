@@ -0,0 +1,46 @@
+//
+//	DiskArrays.h
+//
+
+#ifndef DISKARRAYS_H
+#define DISKARRAYS_H
+
+#include <vector>
+
+// a compact structure-of-arrays copy of disk centers and radii,
+// so the disk searches stream through plain arrays instead of
+// whole Disk objects (each with its heightmap); slot i holds disk
+// getDiskIndex(i)
+class DiskArrays {
+public:
+	/* member functions */
+	void clear();
+	void add(double x, double z, float radius, unsigned int disk_index);
+	unsigned int getSize() const { return m_x.size(); }
+	unsigned int getDiskIndex(unsigned int slot) const { return m_disk_index[slot]; }
+
+	// search kernels over slots [begin, end); each one updates the
+	// best result passed in, breaking ties on the lower disk index
+	// so the result does not depend on the slot order
+
+	// the disk with the least (XZ distance - radius)
+	void findClosest(unsigned int begin, unsigned int end,
+		double x, double z, int& best_disk, double& best_distance) const;
+	// the disk with the nearest center among those with
+	// XZ distance < radius + query_radius, measured in float
+	void findNumber(unsigned int begin, unsigned int end,
+		double x, double z, float query_radius, int& min_i, float& min_dist) const;
+	// every disk whose edge is within slack of the edge of the
+	// disk at (x, z), appended in slot order
+	void findTouching(double x, double z, float radius, unsigned int begin, unsigned int end,
+		double slack, std::vector<unsigned int>& touching) const;
+
+private:
+	/* member variables */
+	std::vector<double> m_x;
+	std::vector<double> m_z;
+	std::vector<float> m_radius;
+	std::vector<unsigned int> m_disk_index;
+};
+
+#endif
@@ -0,0 +1,108 @@
+//
+//	DiskGrid.cpp
+//
+
+#include <algorithm>
+#include <cmath>
+#include "DiskGrid.h"
+
+using namespace std;
+using namespace ObjLibrary;
+
+DiskGrid::DiskGrid()
+	: m_min_x(0.0)
+	, m_min_z(0.0)
+	, m_cell_size(1.0)
+	, m_column_count(0)
+	, m_row_count(0)
+{}
+
+// this function sizes the grid to the bounding box of all disks
+// and fills the cells in two passes (count, then place) so the
+// buckets end up in one flat array
+void DiskGrid::init(const vector<Disk>& disks)
+{
+	m_cell_start.clear();
+	m_disks.clear();
+	m_column_count = 0;
+	m_row_count = 0;
+	if (disks.empty())
+		return;
+
+	double max_x = -HUGE_VAL, max_z = -HUGE_VAL;
+	double total_radius = 0.0;
+	m_min_x = HUGE_VAL;
+	m_min_z = HUGE_VAL;
+	for (unsigned int i = 0; i < disks.size(); i++) {
+		Vector3 position = disks[i].getPosition();
+		double radius = disks[i].getRadius();
+		m_min_x = min(m_min_x, position.x - radius);
+		m_min_z = min(m_min_z, position.z - radius);
+		max_x = max(max_x, position.x + radius);
+		max_z = max(max_z, position.z + radius);
+		total_radius += radius;
+	}
+
+	// a cell about one disk across, but never more cells than disks
+	double span = max(max_x - m_min_x, max_z - m_min_z);
+	m_cell_size = max(2.0 * total_radius / disks.size(), span / sqrt((double)disks.size()));
+	if (m_cell_size <= 0.0)
+		m_cell_size = 1.0;
+	m_column_count = (int)((max_x - m_min_x) / m_cell_size) + 1;
+	m_row_count = (int)((max_z - m_min_z) / m_cell_size) + 1;
+
+	vector<unsigned int> cell_count(m_column_count * m_row_count + 1, 0);
+	vector<unsigned int> slot_disk;
+	for (int pass = 0; pass < 2; pass++) {
+		for (unsigned int i = 0; i < disks.size(); i++) {
+			Vector3 position = disks[i].getPosition();
+			double radius = disks[i].getRadius();
+			int column0 = getColumn(position.x - radius);
+			int column1 = getColumn(position.x + radius);
+			int row0 = getRow(position.z - radius);
+			int row1 = getRow(position.z + radius);
+			for (int row = row0; row <= row1; row++)
+				for (int column = column0; column <= column1; column++) {
+					if (pass == 0)
+						cell_count[indexing(column, row)]++;
+					else
+						slot_disk[cell_count[indexing(column, row)]++] = i;
+				}
+		}
+
+		if (pass == 0) {
+			// turn the counts into start offsets
+			m_cell_start.assign(cell_count.size(), 0);
+			for (unsigned int c = 1; c < cell_count.size(); c++)
+				m_cell_start[c] = m_cell_start[c - 1] + cell_count[c - 1];
+			slot_disk.resize(m_cell_start.back());
+			cell_count = m_cell_start;
+		}
+	}
+
+	for (unsigned int slot = 0; slot < slot_disk.size(); slot++) {
+		const Disk& disk = disks[slot_disk[slot]];
+		m_disks.add(disk.getPosition().x, disk.getPosition().z, disk.getRadius(), slot_disk[slot]);
+	}
+}
+
+int DiskGrid::getColumn(double x) const
+{
+	return toCell(x - m_min_x, m_column_count);
+}
+
+int DiskGrid::getRow(double z) const
+{
+	return toCell(z - m_min_z, m_row_count);
+}
+
+int DiskGrid::toCell(double offset, int count) const
+{
+	double cell = floor(offset / m_cell_size);
+	if (!(cell > 0.0))
+		return 0;
+	else if (cell >= count - 1)
+		return count - 1;
+	else
+		return (int)cell;
+}
@@ -0,0 +1,62 @@
+//
+//	DiskGrid.h
+//
+
+#ifndef DISKGRID_H
+#define DISKGRID_H
+
+#include <vector>
+#include "Disk.h"
+#include "DiskArrays.h"
+
+// a uniform bucket grid over the XZ plane; every disk is stored
+// in each cell that its bounding square overlaps, so a query only
+// has to look at the cells around the query position.  The cells
+// are laid out row by row in one DiskArrays, so a run of cells in
+// a row is one contiguous range of slots.
+class DiskGrid {
+public:
+	/* constructors and destructor */
+	DiskGrid();
+	~DiskGrid() = default;
+
+	/* member functions */
+	void init(const std::vector<Disk>& disks);
+	bool isEmpty() const { return m_cell_start.empty(); }
+	int getColumnCount() const { return m_column_count; }
+	int getRowCount() const { return m_row_count; }
+	// the cell containing x (or z), clamped to the grid
+	int getColumn(double x) const;
+	int getRow(double z) const;
+	double getColumnMinX(int column) const { return m_min_x + column * m_cell_size; }
+	double getRowMinZ(int row) const { return m_min_z + row * m_cell_size; }
+	// the disks of a cell are in slots getCellBegin() to
+	// getCellEnd() - 1 of getDisks()
+	unsigned int getCellBegin(int column, int row) const
+	{
+		return m_cell_start[indexing(column, row)];
+	}
+	unsigned int getCellEnd(int column, int row) const
+	{
+		return m_cell_start[indexing(column, row) + 1];
+	}
+	const DiskArrays& getDisks() const { return m_disks; }
+
+private:
+	int indexing(int column, int row) const
+	{
+		return row * m_column_count + column;
+	}
+	int toCell(double offset, int count) const;
+
+	/* member variables */
+	double m_min_x;
+	double m_min_z;
+	double m_cell_size;
+	int m_column_count;
+	int m_row_count;
+	std::vector<unsigned int> m_cell_start;
+	DiskArrays m_disks;
+};
+
+#endif
@@ -25,8 +25,22 @@ void Enemy::init(World & g_world)
 
 void Enemy::update(Player& player)
 {
+	// move every bat, then find the ground under all of them in one pass
+	m_bat_positions.resize(m_bats.size());
+	m_bat_cursors.resize(m_bats.size());
+	m_bat_heights.resize(m_bats.size());
 	for (int i = 0; i < (int)m_bats.size(); i++) {
-		m_bats[i].update(m_world, player);
+		m_bats[i].move(m_world, player);
+		m_bat_positions[i] = m_bats[i].getPosition();
+		m_bat_cursors[i] = m_bats[i].getCursor();
+	}
+	if (!m_bats.empty())
+		m_world.getHeights(m_bat_cursors.data(), m_bat_positions.data(), m_bats.size(),
+			Bat::getRadius(), m_bat_heights.data());
+
+	for (int i = 0; i < (int)m_bats.size(); i++) {
+		m_bats[i].getCursor() = m_bat_cursors[i];
+		m_bats[i].land(m_bat_heights[i], player);
 		if (m_bats[i].isDead()) {
 			updateList(m_bats[i].getHitVelocity());
 		}
@@ -24,6 +24,11 @@ private:
 	std::vector<Bat> m_bats;
 	std::vector<ObjLibrary::Vector3> velocityList;
 	World m_world;
+
+	// reused every update for the batched bat height query
+	std::vector<ObjLibrary::Vector3> m_bat_positions;
+	std::vector<World::Cursor> m_bat_cursors;
+	std::vector<float> m_bat_heights;
 };
 
 #endif
@@ -0,0 +1,196 @@
+//
+//	FractalNoise.cpp
+//
+
+#include <algorithm>
+#include <cmath>
+#include "FractalNoise.h"
+#include "Simd.h"
+
+using namespace std;
+namespace {
+	// the edge factor is 1 at the middle of the square
+	const float EDGE_SCALE = 1.0f / (1.0f - 0.5f*0.5f*0.5f*0.5f*0.5f*0.5f);
+	// the lattice gradients are picked from this many directions by
+	// the top bits of the lattice hash
+	const unsigned int GRADIENT_BITS = 8;
+	const unsigned int GRADIENT_COUNT = 1 << GRADIENT_BITS;
+
+	struct GradientTable {
+		float x[GRADIENT_COUNT];
+		float z[GRADIENT_COUNT];
+	};
+
+	const GradientTable& getGradients()
+	{
+		static const GradientTable TABLE = [] {
+			GradientTable table;
+			for (unsigned int g = 0; g < GRADIENT_COUNT; g++) {
+				double radians = g * 2.0 * 3.14159265358979323846 / GRADIENT_COUNT;
+				table.x[g] = (float)cos(radians);
+				table.z[g] = (float)sin(radians);
+			}
+			return table;
+		}();
+		return TABLE;
+	}
+
+	// the larger of the falloffs toward either edge of one axis
+	float edgeDistance(float x)
+	{
+		float x1 = 1.0f - x;
+		return max(x*x*x*x*x*x, x1*x1*x1*x1*x1*x1);
+	}
+
+	// one octave's part of a grid: the lattice points the samples
+	// fall between, and the cell, fraction and fade of every sample
+	// column and row
+	struct OctaveGrid {
+		int lattice_x0;
+		int lattice_z0;
+		int lattice_w;
+		vector<float> gx, gz;
+		vector<int> column_cell;	// from lattice_x0
+		vector<float> column_frac, column_fade;
+		vector<int> row_cell;		// from lattice_z0
+		vector<float> row_frac, row_fade;
+		// the current row's gradients interpolated toward it, per
+		// lattice column: a sample's value from lattice column c is
+		// row_x[c] * (c - its x) + row_c[c]
+		vector<float> row_x, row_c;
+	};
+}
+
+FractalNoise::FractalNoise(const Octave octaves[], unsigned int count, Random& random)
+{
+	m_octaves.reserve(count);
+	for (unsigned int o = 0; o < count; o++)
+		m_octaves.push_back(NoiseField(octaves[o].grid_size, octaves[o].amplitude, random));
+}
+
+// the noise of each octave is NoiseField::perlinNoise's, except that
+// a lattice gradient is looked up in a table of directions instead
+// of taking the cosine and sine of the whole hash, which took most
+// of the time; the dot products are regrouped: along a row, the 2
+// lattice points of a column blend into one linear function of x,
+// found once per lattice column instead of per sample, with the
+// amplitude folded in
+void FractalNoise::fillGrid(float* out, int stride, int w, int h, float x0, float z0, float step,
+	float edge_size)
+{
+	if (w <= 0 || h <= 0)
+		return;
+
+	vector<float> column_edge(w), row_edge(h);
+	for (int i = 0; i < w; i++)
+		column_edge[i] = edgeDistance((x0 + i * step) / edge_size);
+	for (int j = 0; j < h; j++)
+		row_edge[j] = edgeDistance((z0 + j * step) / edge_size);
+
+	const GradientTable& gradients = getGradients();
+	vector<unsigned int> hashes;
+	vector<OctaveGrid> grids(m_octaves.size());
+	for (unsigned int o = 0; o < m_octaves.size(); o++) {
+		OctaveGrid& grid = grids[o];
+		float grid_size = m_octaves[o].getGridSize();
+		grid.column_cell.resize(w);
+		grid.column_frac.resize(w);
+		grid.column_fade.resize(w);
+		for (int i = 0; i < w; i++) {
+			float x = (x0 + i * step) / grid_size;
+			grid.column_cell[i] = (int)floor(x);
+			grid.column_frac[i] = x - grid.column_cell[i];
+			grid.column_fade[i] = NoiseField::fade(grid.column_frac[i]);
+		}
+		grid.row_cell.resize(h);
+		grid.row_frac.resize(h);
+		grid.row_fade.resize(h);
+		for (int j = 0; j < h; j++) {
+			float z = (z0 + j * step) / grid_size;
+			grid.row_cell[j] = (int)floor(z);
+			grid.row_frac[j] = z - grid.row_cell[j];
+			grid.row_fade[j] = NoiseField::fade(grid.row_frac[j]);
+		}
+
+		// the lattice points from the first sample's cell to one
+		// past the last sample's
+		grid.lattice_x0 = min(grid.column_cell[0], grid.column_cell[w - 1]);
+		grid.lattice_z0 = min(grid.row_cell[0], grid.row_cell[h - 1]);
+		grid.lattice_w = max(grid.column_cell[0], grid.column_cell[w - 1]) - grid.lattice_x0 + 2;
+		int lattice_h = max(grid.row_cell[0], grid.row_cell[h - 1]) - grid.lattice_z0 + 2;
+		hashes.resize(grid.lattice_w * lattice_h);
+		m_octaves[o].fillHashes(grid.lattice_x0, grid.lattice_z0, grid.lattice_w, lattice_h,
+			hashes.data());
+		grid.gx.resize(hashes.size());
+		grid.gz.resize(hashes.size());
+		for (unsigned int p = 0; p < hashes.size(); p++) {
+			unsigned int g = hashes[p] >> (32 - GRADIENT_BITS);
+			grid.gx[p] = gradients.x[g];
+			grid.gz[p] = gradients.z[g];
+		}
+		for (int i = 0; i < w; i++)
+			grid.column_cell[i] -= grid.lattice_x0;
+		for (int j = 0; j < h; j++)
+			grid.row_cell[j] -= grid.lattice_z0;
+		grid.row_x.resize(grid.lattice_w);
+		grid.row_c.resize(grid.lattice_w);
+	}
+
+	for (int j = 0; j < h; j++) {
+		for (unsigned int o = 0; o < grids.size(); o++) {
+			OctaveGrid& grid = grids[o];
+			float amplitude = m_octaves[o].getAmplitude();
+			const float* gx0 = &grid.gx[grid.row_cell[j] * grid.lattice_w];
+			const float* gz0 = &grid.gz[grid.row_cell[j] * grid.lattice_w];
+			const float* gx1 = gx0 + grid.lattice_w;
+			const float* gz1 = gz0 + grid.lattice_w;
+			float z_frac = grid.row_frac[j];
+			float z_fade1 = grid.row_fade[j];
+			float z_fade0 = 1.0f - z_fade1;
+			for (int c = 0; c < grid.lattice_w; c++) {
+				grid.row_x[c] = (gx0[c] * z_fade0 + gx1[c] * z_fade1) * amplitude;
+				grid.row_c[c] = (gz1[c] * (1.0f - z_frac) * z_fade1 - gz0[c] * z_frac * z_fade0)
+					* amplitude;
+			}
+		}
+
+		float* row = out + j * stride;
+		int i = 0;
+#ifdef USE_AVX2
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 edge_scale = _mm256_set1_ps(EDGE_SCALE);
+		const __m256 z_edge = _mm256_set1_ps(row_edge[j]);
+		for (; i + 8 <= w; i += 8) {
+			__m256 sum = _mm256_setzero_ps();
+			for (unsigned int o = 0; o < grids.size(); o++) {
+				const OctaveGrid& grid = grids[o];
+				__m256i cell = _mm256_loadu_si256((const __m256i*)&grid.column_cell[i]);
+				__m256 x_frac = _mm256_loadu_ps(&grid.column_frac[i]);
+				__m256 x_fade1 = _mm256_loadu_ps(&grid.column_fade[i]);
+				__m256 left = _mm256_sub_ps(_mm256_i32gather_ps(grid.row_c.data(), cell, 4),
+					_mm256_mul_ps(_mm256_i32gather_ps(grid.row_x.data(), cell, 4), x_frac));
+				__m256 right = _mm256_add_ps(_mm256_i32gather_ps(grid.row_c.data() + 1, cell, 4),
+					_mm256_mul_ps(_mm256_i32gather_ps(grid.row_x.data() + 1, cell, 4),
+					_mm256_sub_ps(one, x_frac)));
+				sum = _mm256_add_ps(sum, _mm256_add_ps(left,
+					_mm256_mul_ps(_mm256_sub_ps(right, left), x_fade1)));
+			}
+			__m256 edge = _mm256_mul_ps(_mm256_sub_ps(one,
+				_mm256_max_ps(_mm256_loadu_ps(&column_edge[i]), z_edge)), edge_scale);
+			_mm256_storeu_ps(row + i, _mm256_mul_ps(sum, edge));
+		}
+#endif
+		for (; i < w; i++) {
+			float sum = 0.0f;
+			for (unsigned int o = 0; o < grids.size(); o++) {
+				const OctaveGrid& grid = grids[o];
+				int c = grid.column_cell[i];
+				float x_frac = grid.column_frac[i];
+				float left = grid.row_c[c] - grid.row_x[c] * x_frac;
+				float right = grid.row_c[c + 1] + grid.row_x[c + 1] * (1.0f - x_frac);
+				sum += left + (right - left) * grid.column_fade[i];
+			}
+			row[i] = sum * ((1.0f - max(column_edge[i], row_edge[j])) * EDGE_SCALE);
+		}
+	}
+}
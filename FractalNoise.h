@@ -0,0 +1,42 @@
+//
+//	FractalNoise.h
+//
+
+#ifndef FRACTALNOISE_H
+#define FRACTALNOISE_H
+
+#include <vector>
+#include "NoiseField.h"
+#include "Random.h"
+
+// a sum of Perlin noise octaves (each with the lattice of a
+// NoiseField), evaluated over a grid in one pass:
+// each octave's lattice and the fades of its sample rows and columns
+// are set up once, and every sample adds up all the octaves and the
+// edge fall-off in a single loop (8 samples per step with AVX2)
+class FractalNoise {
+public:
+	struct Octave {
+		float grid_size;
+		float amplitude;
+	};
+
+	/* constructors and destructor */
+	// the octaves take their seeds from random in order, as the same
+	// NoiseFields constructed one after another would
+	FractalNoise(const Octave octaves[], unsigned int count, Random& random);
+	~FractalNoise() = default;
+
+	/* member functions */
+	// the noise at x0 + i * step, z0 + j * step into
+	// out[j * stride + i], scaled by a factor that is 1 in the middle
+	// of the square from 0 to edge_size and falls to 0 at its edges
+	void fillGrid(float* out, int stride, int w, int h, float x0, float z0, float step,
+		float edge_size);
+
+private:
+	/* member variables */
+	std::vector<NoiseField> m_octaves;
+};
+
+#endif
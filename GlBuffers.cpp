@@ -0,0 +1,39 @@
+//
+//	GlBuffers.cpp
+//
+
+#ifndef _WIN32
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include "GlBuffers.h"
+#ifdef _WIN32
+#include "freeglut_ext.h"
+#endif
+
+namespace GlBuffers
+{
+	GenBuffersFunction genBuffers = NULL;
+	DeleteBuffersFunction deleteBuffers = NULL;
+	BindBufferFunction bindBuffer = NULL;
+	BufferDataFunction bufferData = NULL;
+}
+
+bool GlBuffers::load()
+{
+	if (bufferData != NULL)
+		return true;
+#ifdef _WIN32
+	genBuffers = (GenBuffersFunction)glutGetProcAddress("glGenBuffers");
+	deleteBuffers = (DeleteBuffersFunction)glutGetProcAddress("glDeleteBuffers");
+	bindBuffer = (BindBufferFunction)glutGetProcAddress("glBindBuffer");
+	bufferData = (BufferDataFunction)glutGetProcAddress("glBufferData");
+#else
+	genBuffers = &glGenBuffers;
+	deleteBuffers = &glDeleteBuffers;
+	bindBuffer = &glBindBuffer;
+	bufferData = &glBufferData;
+#endif
+	if (genBuffers == NULL || deleteBuffers == NULL || bindBuffer == NULL)
+		bufferData = NULL;
+	return bufferData != NULL;
+}
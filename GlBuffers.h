@@ -0,0 +1,42 @@
+//
+//	GlBuffers.h
+//
+
+#ifndef GLBUFFERS_H
+#define GLBUFFERS_H
+
+#include <cstddef>
+#include "GetGlut.h"
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_STATIC_DRAW 0x88E4
+#endif
+
+// the buffer object functions of OpenGL 1.5; the Windows headers and
+// opengl32.lib stop at OpenGL 1.1, so there they are looked up
+// through freeglut, and elsewhere they are linked directly
+namespace GlBuffers
+{
+	typedef void (APIENTRY *GenBuffersFunction)(GLsizei n, GLuint* buffers);
+	typedef void (APIENTRY *DeleteBuffersFunction)(GLsizei n, const GLuint* buffers);
+	typedef void (APIENTRY *BindBufferFunction)(GLenum target, GLuint buffer);
+	typedef void (APIENTRY *BufferDataFunction)(GLenum target, ptrdiff_t size,
+		const void* data, GLenum usage);
+
+	extern GenBuffersFunction genBuffers;
+	extern DeleteBuffersFunction deleteBuffers;
+	extern BindBufferFunction bindBuffer;
+	extern BufferDataFunction bufferData;
+
+	// finds the functions, once there is a GL context; false if the
+	// driver does not have them
+	bool load();
+
+};  // end of namespace GlBuffers
+
+#endif
@@ -3,86 +3,413 @@
 //
 
 #include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
 #include "Heightmap.h"
 #include "DiskType.h"
+#include "FractalNoise.h"
+#include "GlBuffers.h"
+#include "HeightmapCache.h"
+#include "Simd.h"
 
 using namespace std;
 using namespace ObjLibrary;
 namespace {
-	float randomInterval(float min, float max)
+	// change this whenever a generator produces different heights,
+	// or they are laid out differently, so the heightmap cache does
+	// not return the old ones
+	const unsigned int GENERATOR_VERSION = 5;
+	// the icy cones are binned in squares of cells one AVX2 step wide
+	const int ICY_BIN_SIZE = 8;
+	// extra reach for rounding, so a cone left out of a bin surely
+	// cannot change any of its cells
+	const float ICY_BIN_MARGIN = 0.01f;
+	// how far the skirt of a decimated mesh hangs below its edge
+	const float SKIRT_DEPTH = 1.0f;
+	// the way once around the edge of a mesh, (size, size) to
+	// (size, 0) to (0, 0) to (0, size) and back, so the skirt faces
+	// outward
+	const int EDGE_CORNER_X[5] = { 1, 1, 0, 0, 1 };
+	const int EDGE_CORNER_Z[5] = { 1, 0, 0, 1, 1 };
+	// the octaves of a split terrain: those of a grey rock disk and
+	// two broader ones, for hills that span several tiles
+	const FractalNoise::Octave TILE_OCTAVES[] =
 	{
-		float random01 = (rand() / (RAND_MAX + 1.0f));
-		return (random01 * (max - min) + min);
+		{ 128.0f, 20.0f },
+		{ 64.0f, 14.0f },
+		{ 32.0f, 10.0f },
+		{ 16.0f, 7.0f },
+		{ 8.0f, 5.0f },
+		{ 4.0f, 3.5f },
+		{ 2.0f, 2.5f },
+	};
+	const unsigned int TILE_OCTAVE_COUNT = sizeof(TILE_OCTAVES) / sizeof(TILE_OCTAVES[0]);
+
+	struct TerrainVertex {
+		float x, y, z;
+		float s, t;
+	};
+
+	// the number of samples stored for a heightmap of side size
+	unsigned int getSampleCount(int size)
+	{
+		return (size + 1) * (size + 1);
+	}
+
+	// the number of squares in the min/max pyramid of a heightmap
+	// of side size
+	unsigned int getPyramidSize(int size)
+	{
+		unsigned int count = 0;
+		for (int side = (size + 1) / 2; ; side = (side + 1) / 2) {
+			count += side * side;
+			if (side == 1)
+				return count;
+		}
+	}
+
+	// sample i of the edge walk around a mesh of side size
+	void getEdgePoint(int i, int size, int& x, int& z)
+	{
+		int side = i / size;
+		int step = i % size;
+		x = EDGE_CORNER_X[side] * size + (EDGE_CORNER_X[side + 1] - EDGE_CORNER_X[side]) * step;
+		z = EDGE_CORNER_Z[side] * size + (EDGE_CORNER_Z[side + 1] - EDGE_CORNER_Z[side]) * step;
 	}
 }
 
-Heightmap::Heightmap(int diskType)
+atomic<size_t> Heightmap::s_resident_bytes(0);
+unsigned int Heightmap::s_frame = 0;
+bool Heightmap::s_is_compact = false;
+int Heightmap::s_icy_cone_count = 200;
+vector<Heightmap::IndexBuffer> Heightmap::s_index_buffers;
+
+Heightmap::Heightmap(int diskType, uint64_t seed)
+	: Heightmap(diskType, seed, 0, 0, 1)
+{}
+
+Heightmap::Heightmap(int diskType, uint64_t seed, int tile_column, int tile_row, int tile_count)
 	: m_diskType(diskType)
 	, m_heightmap_size(DiskType::getSideLength(m_diskType))
 	, m_repeat(DiskType::getTexureRepeatCount(m_diskType))
-	, m_heights(m_heightmap_size * m_heightmap_size, 0.0f)
+	, m_seed(seed)
+	, m_tile_column(tile_column)
+	, m_tile_row(tile_row)
+	, m_tile_count(tile_count)
+	, m_resident(false)
+	, m_is_compact(false)
+	, m_scale(0.0f)
+	, m_offset(0.0f)
+	, m_last_used(s_frame)
+	, m_vertex_buffer(0)
+	, m_heights_kernel(getHeightsKernel(m_heightmap_size))
+{}
 
+Heightmap::Heightmap()
+	: m_diskType(), m_heightmap_size(0), m_repeat(0), m_seed(0)
+	, m_tile_column(0), m_tile_row(0), m_tile_count(1)
+	, m_resident(false)
+	, m_is_compact(false), m_scale(0.0f), m_offset(0.0f)
+	, m_last_used(0)
+	, m_vertex_buffer(0), m_heights_kernel(getHeightsKernel(0)) {}
+
+Heightmap::~Heightmap()
 {
-	initHeightmapHeights();
-	initHeightmapDisplayList();
+	if (isResident())
+		s_resident_bytes -= getMemorySize();
+	if (m_vertex_buffer != 0)
+		GlBuffers::deleteBuffers(1, &m_vertex_buffer);
 }
 
-Heightmap::Heightmap()
-	: m_diskType(), m_heightmap_size(0), m_repeat(0) {}
+// the index buffer of a type is made the first time the type is
+// drawn; the vertex buffers are all drawn through the same pointers
+void Heightmap::beginDraw(int disk_type)
+{
+	if (!GlBuffers::load())
+		exit(1);	// no vertex buffers (OpenGL 1.5)
+	if (s_index_buffers.empty())
+		s_index_buffers.assign(DiskType::COUNT, IndexBuffer());
+	if (s_index_buffers[disk_type].buffer == 0)
+		initIndexBuffer(disk_type);
+
+	glEnable(GL_TEXTURE_2D);
+	TextureManager::activate(DiskType::getTextureName(disk_type));
+	glColor3d(1.0, 1.0, 1.0);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	GlBuffers::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_index_buffers[disk_type].buffer);
+}
 
-void Heightmap::draw()
+void Heightmap::endDraw()
 {
-	heightmap_list.draw();
+	GlBuffers::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	GlBuffers::bindBuffer(GL_ARRAY_BUFFER, 0);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisable(GL_TEXTURE_2D);
+}
+
+// the vertex buffer is made the first time the heights are drawn
+// after they became resident, since only the GL thread can do that
+void Heightmap::draw(bool can_build, unsigned int level)
+{
+	assert(level < LOD_COUNT);
+	if (can_build)
+		makeResident();
+	else if (!isResident())
+		return;
+	if (m_vertex_buffer == 0)
+		initVertexBuffer();
+
+	const IndexBuffer& indexes = s_index_buffers[m_diskType];
+	GlBuffers::bindBuffer(GL_ARRAY_BUFFER, m_vertex_buffer);
+	glVertexPointer(3, GL_FLOAT, sizeof(TerrainVertex), (const void*)offsetof(TerrainVertex, x));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(TerrainVertex), (const void*)offsetof(TerrainVertex, s));
+	glDrawElements(GL_TRIANGLES, indexes.offsets[level + 1] - indexes.offsets[level],
+		GL_UNSIGNED_SHORT, (const void*)(indexes.offsets[level] * sizeof(GLushort)));
+}
+
+// a double-checked once-initialization: the flag is read without
+// locking once the heights are built, and the mutex makes a second
+// caller wait for the heights the first one is building instead of
+// building them again (std::call_once cannot be reset by evict);
+// the heights come from the heightmap cache when it has them
+void Heightmap::makeResident() const
+{
+	if (isResident())
+		return;
+	lock_guard<mutex> lock(m_mutex);
+	if (isResident())
+		return;
+	m_heights.assign(getSampleCount(m_heightmap_size), 0.0f);
+	unsigned int setting = m_diskType == DiskType::ICY ? s_icy_cone_count : 0;
+	if (m_tile_count > 1)
+		setting = (m_tile_count << 16) | (m_tile_row * m_tile_count + m_tile_column);
+	uint64_t key = HeightmapCache::getKey(m_seed, m_diskType, GENERATOR_VERSION, setting);
+	if (!HeightmapCache::load(key, m_heights.data(), m_heights.size())) {
+		initHeightmapHeights();
+		HeightmapCache::store(key, m_heights.data(), m_heights.size());
+	}
+	m_is_compact = s_is_compact;
+	if (m_is_compact)
+		quantizeHeights();
+	initPyramid();
+	s_resident_bytes += getMemorySize();
+	m_resident.store(true, memory_order_release);
+}
+
+void Heightmap::evict()
+{
+	lock_guard<mutex> lock(m_mutex);
+	if (!isResident())
+		return;
+	// sized while still resident, so by this heightmap's own storage
+	s_resident_bytes -= getMemorySize();
+	m_resident.store(false, memory_order_release);
+	vector<float>().swap(m_heights);
+	vector<float>().swap(m_pyramid_min);
+	vector<float>().swap(m_pyramid_max);
+	vector<int16_t>().swap(m_compact_heights);
+	if (m_vertex_buffer != 0) {
+		GlBuffers::deleteBuffers(1, &m_vertex_buffer);
+		m_vertex_buffer = 0;
+	}
+}
+
+unsigned int Heightmap::getMemorySize() const
+{
+	bool is_compact = isResident() ? m_is_compact : s_is_compact;
+	unsigned int sample_count = getSampleCount(m_heightmap_size);
+	unsigned int pyramid_bytes = 2 * getPyramidSize(m_heightmap_size) * sizeof(float);
+	if (is_compact)
+		return (sample_count + 1) * sizeof(int16_t) + pyramid_bytes;
+	else
+		return sample_count * sizeof(float) + pyramid_bytes;
 }
 
-void Heightmap::initHeightmapHeights()
+// the extra column and row repeat the first ones, the corner too
+void Heightmap::padBorders(vector<float>& samples) const
 {
+	int h = m_heightmap_size;
+	for (int k = 0; k < h; k++)
+		samples[indexing(h, k)] = samples[indexing(0, k)];
+	for (int i = 0; i <= h; i++)
+		samples[indexing(i, h)] = samples[indexing(i, 0)];
+}
+
+// level 1 is found from the 3 x 3 samples at the corners of each
+// square's cells, since the heights between samples are linear, and
+// each level above from the 4 squares below it; the samples are
+// read after any quantizing, so the bounds hold for the heights
+// getHeight returns
+void Heightmap::initPyramid() const
+{
+	int size = m_heightmap_size;
+	m_pyramid_min.resize(getPyramidSize(size));
+	m_pyramid_max.resize(m_pyramid_min.size());
+	m_pyramid_start.assign(1, 0);
+
+	int side = (size + 1) / 2;
+	for (int row = 0; row < side; row++)
+		for (int column = 0; column < side; column++) {
+			float least = HUGE_VALF;
+			float greatest = -HUGE_VALF;
+			for (int k = 2 * row; k <= min(2 * row + 2, size); k++)
+				for (int i = 2 * column; i <= min(2 * column + 2, size); i++) {
+					float height = getSample(indexing(i, k));
+					least = min(least, height);
+					greatest = max(greatest, height);
+				}
+			m_pyramid_min[row * side + column] = least;
+			m_pyramid_max[row * side + column] = greatest;
+		}
+
+	while (side > 1) {
+		unsigned int below = m_pyramid_start.back();
+		int below_side = side;
+		side = (side + 1) / 2;
+		unsigned int start = below + below_side * below_side;
+		m_pyramid_start.push_back(start);
+		for (int row = 0; row < side; row++)
+			for (int column = 0; column < side; column++) {
+				float least = HUGE_VALF;
+				float greatest = -HUGE_VALF;
+				for (int k = 2 * row; k < min(2 * row + 2, below_side); k++)
+					for (int i = 2 * column; i < min(2 * column + 2, below_side); i++) {
+						least = min(least, m_pyramid_min[below + k * below_side + i]);
+						greatest = max(greatest, m_pyramid_max[below + k * below_side + i]);
+					}
+				m_pyramid_min[start + row * side + column] = least;
+				m_pyramid_max[start + row * side + column] = greatest;
+			}
+	}
+}
+
+// the heights are centered on m_offset and rounded to the nearest
+// of 65535 steps spanning their range
+void Heightmap::quantizeHeights() const
+{
+	float min_height = *min_element(m_heights.begin(), m_heights.end());
+	float max_height = *max_element(m_heights.begin(), m_heights.end());
+	m_offset = 0.5f * (min_height + max_height);
+	m_scale = (max_height - min_height) / 65534.0f;
+
+	m_compact_heights.assign(m_heights.size() + 1, 0);
+	if (m_scale > 0.0f)
+		for (unsigned int i = 0; i < m_heights.size(); i++)
+			m_compact_heights[i] = (int16_t)lround((m_heights[i] - m_offset) / m_scale);
+	vector<float>().swap(m_heights);
+}
+
+// every heightmap has its own random stream starting at m_seed, so
+// the same heights come out on every call on any thread
+void Heightmap::initHeightmapHeights() const
+{
+	if (m_tile_count > 1) {
+		int h = m_heightmap_size;
+		tileGenerator(0, 0, h + 1, h + 1, m_heights.data(), h + 1);
+		return;
+	}
+
+	Random random(m_seed);
 	switch (m_diskType) {
-	case DiskType::RED_ROCK: redRockGenerator();
+	case DiskType::RED_ROCK: redRockGenerator(random);
 		break;
-	case DiskType::LEAFY: leafyGenerator();
+	case DiskType::LEAFY: leafyGenerator(random);
 		break;
-	case DiskType::ICY: icyGenerator();
+	case DiskType::ICY: icyGenerator(random);
 		break;
-	case DiskType::SANDY: sandyGenerator();
+	case DiskType::SANDY: sandyGenerator(random);
 		break;
-	case DiskType::GREY_ROCK: greyRockGenerator();
+	case DiskType::GREY_ROCK: greyRockGenerator(random);
 		break;
 	default: exit(1);
 	}
+	padBorders(m_heights);
 }
 
-void Heightmap::initHeightmapDisplayList()
+// the vertices of every sample, with the column and row past the
+// end wrapping around to the first as getHeight does, and then a
+// second copy of the edge samples, SKIRT_DEPTH lower, in the order
+// of the edge walk
+void Heightmap::initVertexBuffer()
 {
-	heightmap_list.begin();
-	glEnable(GL_TEXTURE_2D);
-	TextureManager::activate(DiskType::getTextureName(m_diskType));
-	glColor3d(1.0, 1.0, 1.0);
-	for (int x0 = 0; x0 < m_heightmap_size; x0++)
-	{
-		unsigned int x1 = x0 + 1;
-		float tex_x0 = (float)(x0) / m_heightmap_size * m_repeat;
-		float tex_x1 = (float)(x1) / m_heightmap_size * m_repeat;
-		glBegin(GL_TRIANGLE_STRIP);
-		for (int z = 0; z <= m_heightmap_size; z++)
-		{
-			float tex_z = (float)(z) / m_heightmap_size * m_repeat;
-			glTexCoord2d(tex_x1, tex_z);
-			glVertex3d(x1, m_heights[indexing(x1 % m_heightmap_size, z % m_heightmap_size)], z);
-			glTexCoord2d(tex_x0, tex_z);
-			glVertex3d(x0, m_heights[indexing(x0 % m_heightmap_size, z % m_heightmap_size)], z);
+	int size = m_heightmap_size;
+	vector<TerrainVertex> vertices;
+	vertices.reserve((size + 1) * (size + 1) + 4 * size);
+	for (int z = 0; z <= size; z++)
+		for (int x = 0; x <= size; x++) {
+			TerrainVertex vertex = { (float)x, getSample(indexing(x, z)), (float)z,
+				(float)(x) / size * m_repeat, (float)(z) / size * m_repeat };
+			vertices.push_back(vertex);
 		}
-		glEnd();
+	for (int i = 0; i < 4 * size; i++) {
+		int x, z;
+		getEdgePoint(i, size, x, z);
+		TerrainVertex vertex = vertices[z * (size + 1) + x];
+		vertex.y -= SKIRT_DEPTH;
+		vertices.push_back(vertex);
 	}
-	glDisable(GL_TEXTURE_2D);
-	heightmap_list.end();
+
+	GlBuffers::genBuffers(1, &m_vertex_buffer);
+	GlBuffers::bindBuffer(GL_ARRAY_BUFFER, m_vertex_buffer);
+	GlBuffers::bufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(TerrainVertex),
+		vertices.data(), GL_STATIC_DRAW);
 }
 
-void Heightmap::redRockGenerator()
+// level l uses every step-th sample in each direction, splitting each
+// cell along the same diagonal as getHeight; a decimated level also
+// hangs a skirt from its edge, so a crack against a finer mesh
+// beside it shows the skirt rather than the background
+void Heightmap::initIndexBuffer(int disk_type)
+{
+	int size = DiskType::getSideLength(disk_type);
+	int row = size + 1;
+	GLushort first_skirt = (GLushort)(row * row);
+	IndexBuffer& buffer = s_index_buffers[disk_type];
+	vector<GLushort> indexes;
+	for (unsigned int level = 0; level < LOD_COUNT; level++) {
+		int step = 1 << level;
+		assert(size % step == 0);
+		buffer.offsets[level] = indexes.size();
+		for (int z0 = 0; z0 < size; z0 += step)
+			for (int x0 = 0; x0 < size; x0 += step) {
+				GLushort corner00 = (GLushort)(z0 * row + x0);
+				GLushort corner10 = (GLushort)(corner00 + step);
+				GLushort corner01 = (GLushort)(corner00 + step * row);
+				GLushort corner11 = (GLushort)(corner01 + step);
+				GLushort cell[6] = { corner10, corner00, corner11, corner11, corner00, corner01 };
+				indexes.insert(indexes.end(), cell, cell + 6);
+			}
+
+		if (level > 0)
+			for (int i = 0; i < 4 * size; i += step) {
+				int next = (i + step) % (4 * size);
+				int x, z, next_x, next_z;
+				getEdgePoint(i, size, x, z);
+				getEdgePoint(next, size, next_x, next_z);
+				GLushort top = (GLushort)(z * row + x);
+				GLushort next_top = (GLushort)(next_z * row + next_x);
+				GLushort bottom = (GLushort)(first_skirt + i);
+				GLushort next_bottom = (GLushort)(first_skirt + next);
+				GLushort quad[6] = { top, bottom, next_top, next_top, bottom, next_bottom };
+				indexes.insert(indexes.end(), quad, quad + 6);
+			}
+	}
+	buffer.offsets[LOD_COUNT] = indexes.size();
+
+	GlBuffers::genBuffers(1, &buffer.buffer);
+	GlBuffers::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.buffer);
+	GlBuffers::bufferData(GL_ELEMENT_ARRAY_BUFFER, indexes.size() * sizeof(GLushort),
+		indexes.data(), GL_STATIC_DRAW);
+}
+
+void Heightmap::redRockGenerator(Random& random) const
 {
 	float number = 0.0f;
 	for (int i = 2; i <= m_heightmap_size/2; i++) {
-		number += randomInterval(-1.0, 2.0);
+		number += random.nextInterval(-1.0, 2.0);
 		for (int j = i; j<= m_heightmap_size - i; j++) {
 			m_heights[indexing(i,j)] = number;
 			m_heights[indexing(j,i)] = number;
@@ -92,10 +419,10 @@ void Heightmap::redRockGenerator()
 	}
 }
 
-void Heightmap::leafyGenerator()
+void Heightmap::leafyGenerator(Random& random) const
 {
 	float number[11];
-	leafyPreprocess(number);
+	leafyPreprocess(number, random);
 
 	for (int x = 1; x < m_heightmap_size; x++)
 		for (int z = 1; z < m_heightmap_size; z++)
@@ -103,75 +430,151 @@ void Heightmap::leafyGenerator()
 				/ m_heightmap_size, (float)z / m_heightmap_size, number);
 }
 
-void Heightmap::icyGenerator()
+// a cone only raises the cells within y / 0.7 of its apex and only
+// lowers those within -y / 0.7, so each cell only has to look at
+// the cones binned near it, and the heights are exactly what
+// testing every cone would give
+void Heightmap::icyGenerator(Random& random) const
 {
-	Vector3 random_points[200];
-	for (int j = 0; j < 200; j++) {
+	vector<float> apex_x, apex_y, apex_z;
+	for (int j = 0; j < s_icy_cone_count; j++) {
 		float temp, d = 0.0f, h = m_heightmap_size / 2.0f;
 		for (int i = 0; i < 4; i++) {
-			temp = randomInterval(0, h);
+			temp = random.nextInterval(0, h);
 			if (d < temp)
 				d = temp;
 		}
 		float m = (h - d) * 0.7f;
-		float angle = randomInterval(0.0f, 2.0f * PI);
-		float y = randomInterval(m * (-1.0f), m);
-		random_points[j].x = h + cos(angle) * d;
-		random_points[j].y = y;
-		random_points[j].z = h + sin(angle) * d;
+		float angle = random.nextInterval(0.0f, 2.0f * PI);
+		float y = random.nextInterval(m * (-1.0f), m);
+		apex_x.push_back(h + cos(angle) * d);
+		apex_y.push_back(y);
+		apex_z.push_back(h + sin(angle) * d);
 	}
 
-	for (int x = 1; x < m_heightmap_size; x++)
-		for (int z = 1; z < m_heightmap_size; z++)
-			m_heights[indexing(x,z)] = icyHeight((float)x, (float)z, random_points);
+	// bin column c holds cells 1 + c * ICY_BIN_SIZE to
+	// c * ICY_BIN_SIZE + ICY_BIN_SIZE, and the same for rows; the
+	// bins are filled in two passes (count, then place)
+	IcyCones cones;
+	cones.bin_columns = (m_heightmap_size - 2) / ICY_BIN_SIZE + 1;
+	int bin_count = cones.bin_columns * cones.bin_columns;
+	vector<unsigned int> bin_fill(bin_count + 1, 0);
+	for (int pass = 0; pass < 2; pass++) {
+		for (int j = 0; j < s_icy_cone_count; j++) {
+			float reach = fabs(apex_y[j]) / 0.7f + ICY_BIN_MARGIN;
+			for (int row = 0; row < cones.bin_columns; row++)
+				for (int column = 0; column < cones.bin_columns; column++) {
+					// the distance from the apex to the nearest cell of the bin
+					float x0 = (float)(1 + column * ICY_BIN_SIZE);
+					float z0 = (float)(1 + row * ICY_BIN_SIZE);
+					float x1 = min(x0 + ICY_BIN_SIZE - 1, m_heightmap_size - 1.0f);
+					float z1 = min(z0 + ICY_BIN_SIZE - 1, m_heightmap_size - 1.0f);
+					float dx = max(max(x0 - apex_x[j], apex_x[j] - x1), 0.0f);
+					float dz = max(max(z0 - apex_z[j], apex_z[j] - z1), 0.0f);
+					if (dx * dx + dz * dz > reach * reach)
+						continue;
+
+					unsigned int bin = row * cones.bin_columns + column;
+					if (pass == 0)
+						bin_fill[bin]++;
+					else {
+						unsigned int slot = bin_fill[bin]++;
+						cones.x[slot] = apex_x[j];
+						cones.y[slot] = apex_y[j];
+						cones.z[slot] = apex_z[j];
+					}
+				}
+		}
+
+		if (pass == 0) {
+			// turn the counts into start offsets
+			cones.bin_start.assign(bin_count + 1, 0);
+			for (int b = 1; b <= bin_count; b++)
+				cones.bin_start[b] = cones.bin_start[b - 1] + bin_fill[b - 1];
+			cones.x.resize(cones.bin_start.back());
+			cones.y.resize(cones.bin_start.back());
+			cones.z.resize(cones.bin_start.back());
+			bin_fill = cones.bin_start;
+		}
+	}
+
+	for (int z = 1; z < m_heightmap_size; z++)
+		icyRow(z, cones, &m_heights[indexing(0, z)]);
 }
 
-void Heightmap::sandyGenerator()
+void Heightmap::sandyGenerator(Random& random) const
 {
-	NoiseField noiseObject(16.0f, 8.0f);
+	NoiseField noiseObject(16.0f, 8.0f, random);
+	int w = m_heightmap_size - 1;
+	vector<float> noise(w * w);
+	noiseObject.fillGrid(noise.data(), w, w, 1.0f, 1.0f, 1.0f);
 	for (int x = 1; x < m_heightmap_size; x++)
 		for (int z = 1; z < m_heightmap_size; z++)
-			m_heights[indexing(x,z)] = noiseObject.perlinNoise((float)x, (float)z)
+			m_heights[indexing(x,z)] = noise[(z - 1) * w + x - 1]
 			* edgeFactor((float)x / m_heightmap_size, (float)z / m_heightmap_size);
 }
 
-void Heightmap::greyRockGenerator()
+void Heightmap::greyRockGenerator(Random& random) const
 {
-	NoiseField noiseLayer0(32.0f, 10.0f);
-	NoiseField noiseLayer1(16.0f, 7.0f);
-	NoiseField noiseLayer2(8.0f, 5.0f);
-	NoiseField noiseLayer3(4.0f, 3.5f);
-	NoiseField noiseLayer4(2.0f, 2.5f);
-	for (int x = 1; x < m_heightmap_size; x++)
-		for (int z = 1; z < m_heightmap_size; z++)
-			m_heights[indexing(x,z)] = (noiseLayer0.perlinNoise((float)x, (float)z)
-			+ noiseLayer1.perlinNoise((float)x, (float)z)
-			+ noiseLayer2.perlinNoise((float)x, (float)z)
-			+ noiseLayer3.perlinNoise((float)x, (float)z)
-			+ noiseLayer4.perlinNoise((float)x, (float)z))
-			* edgeFactor((float)x / m_heightmap_size, (float)z / m_heightmap_size);
+	const FractalNoise::Octave OCTAVES[] =
+	{
+		{ 32.0f, 10.0f },
+		{ 16.0f, 7.0f },
+		{ 8.0f, 5.0f },
+		{ 4.0f, 3.5f },
+		{ 2.0f, 2.5f },
+	};
+	FractalNoise noise(OCTAVES, 5, random);
+	noise.fillGrid(&m_heights[indexing(1, 1)], m_heightmap_size + 1, m_heightmap_size - 1,
+		m_heightmap_size - 1, 1.0f, 1.0f, 1.0f, (float)m_heightmap_size);
+}
 
+// every tile makes the same noise from the seed, over the samples
+// of the whole terrain, so the samples the tiles share match; the
+// border of the whole terrain and everything past it stays flat, as
+// on a heightmap that is not split
+void Heightmap::tileGenerator(int i0, int k0, int w, int h, float out[], int stride) const
+{
+	Random random(m_seed);
+	FractalNoise noise(TILE_OCTAVES, TILE_OCTAVE_COUNT, random);
+	int terrain_size = m_heightmap_size * m_tile_count;
+	int x0 = m_tile_column * m_heightmap_size + i0;
+	int z0 = m_tile_row * m_heightmap_size + k0;
+	noise.fillGrid(out, stride, w, h, (float)x0, (float)z0, 1.0f, (float)terrain_size);
+	for (int k = 0; k < h; k++)
+		for (int i = 0; i < w; i++)
+			if (x0 + i <= 0 || x0 + i >= terrain_size || z0 + k <= 0 || z0 + k >= terrain_size)
+				out[k * stride + i] = 0.0f;
 }
 
-void Heightmap::leafyPreprocess(float number[])
+void Heightmap::leafyPreprocess(float number[], Random& random) const
 {
 	for (int i = 0; i < 6; i++) {
-		number[i] = randomInterval(-1.0, 1.0);
+		number[i] = random.nextInterval(-1.0, 1.0);
 	}
-	int one = rand() % 7;
-	int two = rand() % 7;
+	int one = random.nextInt(7);
+	int two = random.nextInt(7);
 	number[6] = (float)min(one, two);
-	number[7] = randomInterval(0.0f, 2.0f * PI);
+	number[7] = random.nextInterval(0.0f, 2.0f * PI);
 	float sign;
-	if (rand() % 2)
+	if (random.nextInt(2))
 		sign = 1.0f;
 	else
 		sign = -1.0f;
 	for (int i = 0; i < 3; i++)
-		number[8 + i] = randomInterval(0.0, 1.0) * sign;
+		number[8 + i] = random.nextInterval(0.0, 1.0) * sign;
 }
 
-float Heightmap::leafyHeight(float x, float y, float number[])
+float Heightmap::edgeFactor(float  x, float y) const
+{
+	return (1 - max(max(x*x*x*x*x*x, 
+		(1.0f - x)*(1.0f - x)*(1.0f - x)*(1.0f - x)*(1.0f - x)*(1.0f - x)),
+		max(y*y*y*y*y*y, 
+		(1.0f - y)*(1.0f - y)*(1.0f - y)*(1.0f - y)*(1.0f - y)*(1.0f - y))))
+		/ (1.0f - 0.5f*0.5f*0.5f*0.5f*0.5f*0.5f);
+}
+
+float Heightmap::leafyHeight(float x, float y, float number[]) const
 {
 	//set up all random numbers
 	float LL = number[0];
@@ -214,14 +617,53 @@ float Heightmap::leafyHeight(float x, float y, float number[])
 	return non_arm_height * 5.0f + arm_height * 3.0f;
 }
 
-float Heightmap::icyHeight(float x, float z, Vector3 points[])
+// cells 1 to m_heightmap_size - 1 of row z, 8 cells per step with
+// AVX2, each step inside one bin; the cone loop is the one in
+// icyHeight, with the same float operations, so both paths give
+// identical heights
+void Heightmap::icyRow(int z, const IcyCones& cones, float row[]) const
+{
+	const unsigned int* bin_start = &cones.bin_start[(z - 1) / ICY_BIN_SIZE * cones.bin_columns];
+	int x = 1;
+#ifdef USE_AVX2
+	static_assert(ICY_BIN_SIZE == 8, "an AVX2 step must fill one bin row");
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	const __m256 slope = _mm256_set1_ps(0.7f);
+	const __m256 pz = _mm256_set1_ps((float)z);
+	for (; x + 8 <= m_heightmap_size; x += 8) {
+		int column = (x - 1) / ICY_BIN_SIZE;
+		__m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+		__m256 max_height = zero;
+		__m256 min_height = zero;
+		for (unsigned int i = bin_start[column]; i < bin_start[column + 1]; i++) {
+			__m256 dx = _mm256_sub_ps(px, _mm256_set1_ps(cones.x[i]));
+			__m256 dz = _mm256_sub_ps(pz, _mm256_set1_ps(cones.z[i]));
+			__m256 hor_dist = _mm256_mul_ps(slope,
+				_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dz, dz))));
+			__m256 apex = _mm256_set1_ps(cones.y[i]);
+			max_height = _mm256_max_ps(max_height, _mm256_sub_ps(apex, hor_dist));
+			min_height = _mm256_min_ps(min_height, _mm256_add_ps(apex, hor_dist));
+		}
+		_mm256_storeu_ps(row + x, _mm256_add_ps(max_height, min_height));
+	}
+#endif
+	for (; x < m_heightmap_size; x++) {
+		int column = (x - 1) / ICY_BIN_SIZE;
+		row[x] = icyHeight((float)x, (float)z, cones, bin_start[column], bin_start[column + 1]);
+	}
+}
+
+float Heightmap::icyHeight(float x, float z, const IcyCones& cones,
+	unsigned int begin, unsigned int end) const
 {
 	float minHeight = 0.0f, maxHeight = 0.0f;
-	for (int i = 0; i < 200; i++) {
-		float horDist = 0.7f * (float)sqrt((x - points[i].x)*(x - points[i].x)
-			+ (z - points[i].z)*(z - points[i].z));
-		float p = (float)points[i].y - horDist;
-		float n = (float)points[i].y + horDist;
+	for (unsigned int i = begin; i < end; i++) {
+		float dx = x - cones.x[i];
+		float dz = z - cones.z[i];
+		float horDist = 0.7f * sqrt(dx * dx + dz * dz);
+		float p = cones.y[i] - horDist;
+		float n = cones.y[i] + horDist;
 		if (p > maxHeight)
 			maxHeight = p;
 		if (n < minHeight)
@@ -230,45 +672,300 @@ float Heightmap::icyHeight(float x, float z, Vector3 points[])
 	return maxHeight + minHeight;
 }
 
-float Heightmap::edgeFactor(float  x, float y)
-{
-	return (1 - max(max(x*x*x*x*x*x, 
-		(1.0f - x)*(1.0f - x)*(1.0f - x)*(1.0f - x)*(1.0f - x)*(1.0f - x)),
-		max(y*y*y*y*y*y, 
-		(1.0f - y)*(1.0f - y)*(1.0f - y)*(1.0f - y)*(1.0f - y)*(1.0f - y))))
-		/ (1.0f - 0.5f*0.5f*0.5f*0.5f*0.5f*0.5f);
-}
-
 // add a new function for Assignment 3
 // using the method in Hand out 4-1
 float Heightmap::getHeight(float x, float z) const
+{
+	makeResident();
+	m_last_used = s_frame;
+
+	int corners[3];
+	float weights[3];
+	getTriangle(x, z, corners, weights);
+	return weights[0] * getSample(corners[0])
+		+ weights[1] * getSample(corners[1])
+		+ weights[2] * getSample(corners[2]);
+}
+
+// the heights are linear over each triangle, so its gradient is
+// exact from its corners; the cell is split as in getTriangle
+void Heightmap::getGradient(float x, float z, float& gradient_x, float& gradient_z) const
+{
+	makeResident();
+	m_last_used = s_frame;
+
+	int i = (int)floor(x);
+	int k = (int)floor(z);
+	float h00 = getSample(indexing(i, k));
+	float h11 = getSample(indexing(i + 1, k + 1));
+	if (x - i > z - k) {
+		float h10 = getSample(indexing(i + 1, k));
+		gradient_x = h10 - h00;
+		gradient_z = h11 - h10;
+	}
+	else {
+		float h01 = getSample(indexing(i, k + 1));
+		gradient_x = h11 - h01;
+		gradient_z = h01 - h00;
+	}
+}
+
+void Heightmap::getTriangle(float x, float z, int corners[3], float weights[3]) const
 {
 	int i = (int)floor(x);
 	int k = (int)floor(z);
-	int h = m_heightmap_size;
 
 	float i_frac = x - i;
 	float k_frac = z - k;
 
-	float height;
 	if (i_frac > k_frac) {
-		float w1 = 1.0f - i_frac;
-		float w2 = k_frac;
-		float w0 = 1.0f - w1 - w2;
-
-		height = w0 * m_heights[indexing((i + 1) % h, k)]
-			+ w1 * m_heights[indexing(i, k)]
-			+ w2 * m_heights[indexing((i + 1) % h, (k + 1) % h)];
+		weights[1] = 1.0f - i_frac;
+		weights[2] = k_frac;
+		weights[0] = 1.0f - weights[1] - weights[2];
+		corners[0] = indexing(i + 1, k);
+		corners[1] = indexing(i, k);
+		corners[2] = indexing(i + 1, k + 1);
 	}
 	else {
-		float w2 = i_frac;
-		float w1 = 1.0f - k_frac;
-		float w3 = 1.0f - w1 - w2;
+		weights[1] = i_frac;
+		weights[0] = 1.0f - k_frac;
+		weights[2] = 1.0f - weights[0] - weights[1];
+		corners[0] = indexing(i, k);
+		corners[1] = indexing(i + 1, k + 1);
+		corners[2] = indexing(i, k + 1);
+	}
+}
 
-		height = w1 * m_heights[indexing(i, k)]
-			+ w2 * m_heights[indexing((i + 1) % h, (k + 1) % h)]
-			+ w3 * m_heights[indexing(i, (k + 1) % h)];
+// the same triangles as getTriangle, for a point given by its cell,
+// so a point on the far edge of the last cell is still in it
+float Heightmap::getCellHeight(int i, int k, float x_frac, float z_frac) const
+{
+	float h00 = getSample(indexing(i, k));
+	float h11 = getSample(indexing(i + 1, k + 1));
+	if (x_frac > z_frac)
+		return h00 + (getSample(indexing(i + 1, k)) - h00) * (x_frac - z_frac)
+			+ (h11 - h00) * z_frac;
+	else
+		return h00 + (getSample(indexing(i, k + 1)) - h00) * (z_frac - x_frac)
+			+ (h11 - h00) * x_frac;
+}
+
+// the ray is walked down the min/max pyramid from the square that
+// covers the whole heightmap: a square the ray passes over entirely
+// above its greatest height is skipped, and the 4 squares below one
+// it might hit are tried in the order the ray reaches them, so the
+// first hit found is the nearest
+float Heightmap::raycast(float x, float y, float z, float dx, float dy, float dz, float max_t) const
+{
+	makeResident();
+	m_last_used = s_frame;
+
+	Ray ray = { x, y, z, dx, dy, dz };
+	float hit;
+	int top = m_pyramid_start.size();
+	if (raycastNode(ray, top, 0, 0, 0.0f, max_t, hit))
+		return hit;
+	return -1.0f;
+}
+
+bool Heightmap::raycastNode(const Ray& ray, int level, int column, int row,
+	float t0, float t1, float& hit) const
+{
+	int x0 = column << level;
+	int z0 = row << level;
+	if (!clipRay(ray, x0, z0, min(x0 + (1 << level), m_heightmap_size),
+		min(z0 + (1 << level), m_heightmap_size), t0, t1))
+		return false;
+	if (level == 0)
+		return raycastCell(ray, column, row, t0, t1, hit);
+
+	int side = (m_heightmap_size + (1 << level) - 1) >> level;
+	unsigned int square = m_pyramid_start[level - 1] + row * side + column;
+	float y0 = ray.y + ray.dy * t0;
+	float y1 = ray.y + ray.dy * t1;
+	if (min(y0, y1) > m_pyramid_max[square])
+		return false;
+	if (max(y0, y1) < m_pyramid_min[square]) {
+		hit = t0;
+		return true;
+	}
+
+	// the squares below, sorted by where the ray enters them
+	struct Child {
+		float t0, t1;
+		int column, row;
+	};
+	Child children[4];
+	int child_count = 0;
+	int child_size = 1 << (level - 1);
+	for (int c = 0; c < 4; c++) {
+		Child child = { t0, t1, 2 * column + c % 2, 2 * row + c / 2 };
+		int child_x0 = child.column * child_size;
+		int child_z0 = child.row * child_size;
+		if (child_x0 >= m_heightmap_size || child_z0 >= m_heightmap_size ||
+			!clipRay(ray, child_x0, child_z0, min(child_x0 + child_size, m_heightmap_size),
+			min(child_z0 + child_size, m_heightmap_size), child.t0, child.t1))
+			continue;
+		int slot = child_count++;
+		for (; slot > 0 && children[slot - 1].t0 > child.t0; slot--)
+			children[slot] = children[slot - 1];
+		children[slot] = child;
+	}
+	for (int c = 0; c < child_count; c++)
+		if (raycastNode(ray, level - 1, children[c].column, children[c].row,
+			children[c].t0, children[c].t1, hit))
+			return true;
+	return false;
+}
+
+// within a cell the heights under the ray are linear on each side
+// of the cell's diagonal, so the ray's height above them is checked
+// at the ends of the (at most 2) pieces
+bool Heightmap::raycastCell(const Ray& ray, int i, int k, float t0, float t1, float& hit) const
+{
+	float t[3] = { t0, t1, t1 };
+	int point_count = 2;
+	float diagonal_speed = ray.dx - ray.dz;
+	if (diagonal_speed != 0.0f) {
+		float t_diagonal = ((i - k) - (ray.x - ray.z)) / diagonal_speed;
+		if (t_diagonal > t0 && t_diagonal < t1) {
+			t[1] = t_diagonal;
+			point_count = 3;
+		}
+	}
+
+	float above[3];
+	for (int p = 0; p < point_count; p++) {
+		float x_frac = min(max(ray.x + ray.dx * t[p] - i, 0.0f), 1.0f);
+		float z_frac = min(max(ray.z + ray.dz * t[p] - k, 0.0f), 1.0f);
+		above[p] = ray.y + ray.dy * t[p] - getCellHeight(i, k, x_frac, z_frac);
 	}
-	return height;
+	if (above[0] < 0.0f) {
+		hit = t[0];
+		return true;
+	}
+	for (int p = 1; p < point_count; p++)
+		if (above[p] < 0.0f) {
+			hit = t[p - 1] + (t[p] - t[p - 1]) * above[p - 1] / (above[p - 1] - above[p]);
+			return true;
+		}
+	return false;
 }
 
+bool Heightmap::clipRay(const Ray& ray, int x0, int z0, int x1, int z1,
+	float& t0, float& t1) const
+{
+	const float start[2] = { ray.x, ray.z };
+	const float speed[2] = { ray.dx, ray.dz };
+	const int low[2] = { x0, z0 };
+	const int high[2] = { x1, z1 };
+	for (int axis = 0; axis < 2; axis++) {
+		if (speed[axis] == 0.0f) {
+			if (start[axis] < low[axis] || start[axis] > high[axis])
+				return false;
+			continue;
+		}
+		float enter = (low[axis] - start[axis]) / speed[axis];
+		float leave = (high[axis] - start[axis]) / speed[axis];
+		if (enter > leave)
+			swap(enter, leave);
+		t0 = max(t0, enter);
+		t1 = min(t1, leave);
+	}
+	return t0 <= t1;
+}
+
+void Heightmap::getHeights(const float x[], const float z[], unsigned int count,
+	float heights[]) const
+{
+	makeResident();
+	m_last_used = s_frame;
+	(this->*m_heights_kernel)(x, z, count, heights);
+}
+
+// the side lengths of the disk types get kernels with a fixed row
+// stride, and any other side the general one
+Heightmap::HeightsKernel Heightmap::getHeightsKernel(int side_length)
+{
+	switch (side_length) {
+	case 16: return &Heightmap::getHeightsFor<16>;
+	case 32: return &Heightmap::getHeightsFor<32>;
+	case 48: return &Heightmap::getHeightsFor<48>;
+	case 64: return &Heightmap::getHeightsFor<64>;
+	case 80: return &Heightmap::getHeightsFor<80>;
+	default: return &Heightmap::getHeightsFor<0>;
+	}
+}
+
+// the same interpolation as getHeight, 8 points per step with AVX2;
+// the weights and sums keep getHeight's order of operations so
+// both give identical results
+template <int SIDE>
+void Heightmap::getHeightsFor(const float x[], const float z[], unsigned int count,
+	float heights[]) const
+{
+	const int side = (SIDE != 0) ? SIDE : m_heightmap_size;
+	const float size = (float)side;
+	unsigned int p = 0;
+#ifdef USE_AVX2
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 size8 = _mm256_set1_ps(size);
+	const __m256i stride8i = _mm256_set1_epi32(side + 1);
+	// a compact height is the low half of a 4-byte gather, sign
+	// extended and then scaled the way getSample does it
+	const __m256 scale8 = _mm256_set1_ps(m_scale);
+	const __m256 offset8 = _mm256_set1_ps(m_offset);
+	auto gather = [&](__m256i index) {
+		if (!m_is_compact)
+			return _mm256_i32gather_ps(m_heights.data(), index, 4);
+		__m256i sample = _mm256_i32gather_epi32((const int*)m_compact_heights.data(), index, 2);
+		sample = _mm256_srai_epi32(_mm256_slli_epi32(sample, 16), 16);
+		return _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(sample), scale8), offset8);
+	};
+	for (; p + 8 <= count; p += 8) {
+		__m256 px = _mm256_loadu_ps(x + p);
+		__m256 pz = _mm256_loadu_ps(z + p);
+		__m256 inside = _mm256_and_ps(
+			_mm256_and_ps(_mm256_cmp_ps(px, zero, _CMP_GE_OQ), _mm256_cmp_ps(px, size8, _CMP_LT_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(pz, zero, _CMP_GE_OQ), _mm256_cmp_ps(pz, size8, _CMP_LT_OQ)));
+		px = _mm256_and_ps(px, inside);
+		pz = _mm256_and_ps(pz, inside);
+
+		__m256 fi = _mm256_floor_ps(px);
+		__m256 fk = _mm256_floor_ps(pz);
+		__m256 i_frac = _mm256_sub_ps(px, fi);
+		__m256 k_frac = _mm256_sub_ps(pz, fk);
+		__m256i i0 = _mm256_cvtps_epi32(fi);
+		__m256i k0 = _mm256_cvtps_epi32(fk);
+		__m256i index00 = _mm256_add_epi32(_mm256_mullo_epi32(k0, stride8i), i0);
+
+		// corners shared by both triangles, then the one that differs;
+		// the padding puts them all at fixed offsets from the first
+		__m256 h00 = gather(index00);
+		__m256 h11 = gather(_mm256_add_epi32(index00, _mm256_set1_epi32(side + 2)));
+		__m256 upper = _mm256_cmp_ps(i_frac, k_frac, _CMP_GT_OQ);
+		__m256i corner = _mm256_add_epi32(index00, _mm256_castps_si256(_mm256_blendv_ps(
+			_mm256_castsi256_ps(stride8i), _mm256_castsi256_ps(_mm256_set1_epi32(1)), upper)));
+		__m256 hc = gather(corner);
+
+		__m256 w00 = _mm256_sub_ps(one, _mm256_blendv_ps(k_frac, i_frac, upper));
+		__m256 w11 = _mm256_blendv_ps(i_frac, k_frac, upper);
+		__m256 wc = _mm256_sub_ps(_mm256_sub_ps(one, w00), w11);
+
+		__m256 a00 = _mm256_mul_ps(w00, h00);
+		__m256 a11 = _mm256_mul_ps(w11, h11);
+		__m256 ac = _mm256_mul_ps(wc, hc);
+		__m256 sum_upper = _mm256_add_ps(_mm256_add_ps(ac, a00), a11);
+		__m256 sum_lower = _mm256_add_ps(_mm256_add_ps(a00, a11), ac);
+		__m256 height = _mm256_blendv_ps(sum_lower, sum_upper, upper);
+		_mm256_storeu_ps(heights + p, _mm256_and_ps(height, inside));
+	}
+#endif
+	for (; p < count; p++) {
+		if (x[p] >= 0.0f && x[p] < size && z[p] >= 0.0f && z[p] < size)
+			heights[p] = getHeight(x[p], z[p]);
+		else
+			heights[p] = 0.0f;
+	}
+}
\ No newline at end of file
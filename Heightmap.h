@@ -5,49 +5,202 @@
 #ifndef HEIGHTMAP_H
 #define HEIGHTMAP_H
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <vector>
 #include "ObjLibrary/TextureManager.h"
-#include "ObjLibrary/DisplayList.h"
 #include "ObjLibrary/Vector3.h"
+#include "GetGlut.h"
 #include "NoiseField.h"
+#include "Random.h"
 
+// the heights are generated from the seed of the disk's random
+// stream the first time they are needed, not on construction, and a
+// heightmap that is far from the player can be evicted and later
+// rebuilt exactly as it was
 class Heightmap {
 public:
+	// mesh level l skips to every (1 << l)-th sample; the side
+	// lengths are all multiples of 1 << (LOD_COUNT - 1)
+	static const unsigned int LOD_COUNT = 4;
+
 	/* constructors and destructor */
-	Heightmap(int diskType);
+	Heightmap(int diskType, uint64_t seed);
+	// tile (tile_column, tile_row) of a terrain split into
+	// tile_count x tile_count heightmaps of the usual side length,
+	// which meet without seams; only grey rock terrain can be split
+	Heightmap(int diskType, uint64_t seed, int tile_column, int tile_row, int tile_count);
 	Heightmap();
-	~Heightmap() = default;
+	~Heightmap();
+	Heightmap(const Heightmap&) = delete;
+	Heightmap& operator= (const Heightmap&) = delete;
 
 	/* member functions */
-	void draw();
+	// the heightmaps of one disk type are drawn between beginDraw
+	// and endDraw, which bind the type's texture and index buffer
+	// once for all of them; all three must be called on the GL thread
+	static void beginDraw(int disk_type);
+	static void endDraw();
+	// without can_build nothing is drawn until the heights are
+	// resident; level is the mesh detail, from 0 (every sample) to
+	// LOD_COUNT - 1
+	void draw(bool can_build, unsigned int level = 0);
 	float getHeight(float x, float z) const;
+	// many points at once; points off the heightmap get 0
+	void getHeights(const float x[], const float z[], unsigned int count,
+		float heights[]) const;
+	// the uphill gradient of the heights at (x, z), in height per
+	// heightmap cell: the slope of the triangle getHeight uses there
+	void getGradient(float x, float z, float& gradient_x, float& gradient_z) const;
+	// the first t in [0, max_t] at which the ray (x, y, z) +
+	// t * (dx, dy, dz), in heightmap coordinates, passes below the
+	// heights (0 if it starts below them), or -1 if it does not
+	// within the heightmap
+	float raycast(float x, float y, float z, float dx, float dy, float dz, float max_t) const;
+
+	// residency: makeResident builds the heights once and then only
+	// after an evict; it can be called from any thread, but
+	// evict must be called on the GL thread while no other thread
+	// is reading the heights
+	bool isResident() const { return m_resident.load(std::memory_order_acquire); }
+	void makeResident() const;
+	void evict();
+	unsigned int getMemorySize() const;
+	// the frame of the last height query
+	unsigned int getLastUsed() const { return m_last_used; }
+
+	// the bytes of heights resident in all heightmaps
+	static size_t getResidentBytes() { return s_resident_bytes.load(); }
+	// compact storage, for heightmaps made resident afterwards: the
+	// heights are kept as int16 steps of (max - min) / 65534, half
+	// the memory of floats; a height read back is off by at most half
+	// a step, under 0.15 mm on the stock disk types
+	static void setCompactStorage(bool is_compact) { s_is_compact = is_compact; }
+	// the number of cones that shape an icy disk (200 by default);
+	// this must be set before any heightmap is built
+	static void setIcyConeCount(int count) { s_icy_cone_count = count; }
+	static void setFrame(unsigned int frame) { s_frame = frame; }
+
 private:
+	// the cone apexes of an icy disk, one array per coordinate,
+	// sorted into square bins of cells: the cones that can reach
+	// bin b are in slots bin_start[b] to bin_start[b + 1] - 1
+	struct IcyCones {
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<unsigned int> bin_start;
+		int bin_columns;
+	};
+
+	struct Ray {
+		float x, y, z;
+		float dx, dy, dz;
+	};
+
+	// getHeights for one side length, fixed when SIDE is not 0;
+	// each heightmap picks its kernel once, on construction
+	typedef void (Heightmap::*HeightsKernel)(const float x[], const float z[],
+		unsigned int count, float heights[]) const;
+	template <int SIDE>
+	void getHeightsFor(const float x[], const float z[], unsigned int count,
+		float heights[]) const;
+	static HeightsKernel getHeightsKernel(int side_length);
+
+	// the triangles of every level of one disk type (and so one
+	// side length), shared by all its heightmaps: level l is
+	// elements offsets[l] to offsets[l + 1] - 1
+	struct IndexBuffer {
+		GLuint buffer;
+		unsigned int offsets[LOD_COUNT + 1];
+	};
+
 	// initialize the heightmap class
-	void initHeightmapHeights();
-	void initHeightmapDisplayList();
+	void initHeightmapHeights() const;
+	void quantizeHeights() const;
+	void initPyramid() const;
+	void initVertexBuffer();
+	static void initIndexBuffer(int disk_type);
 	// support functions to calculate heights for 5 disks type
-	void redRockGenerator();
-	void leafyGenerator();
-	void icyGenerator();
-	void sandyGenerator();
-	void greyRockGenerator();
+	void redRockGenerator(Random& random) const;
+	void leafyGenerator(Random& random) const;
+	void icyGenerator(Random& random) const;
+	void sandyGenerator(Random& random) const;
+	void greyRockGenerator(Random& random) const;
+	// the samples from (i0, k0) to (i0 + w - 1, k0 + h - 1) of a
+	// tile, which may reach past it into its neighbours
+	void tileGenerator(int i0, int k0, int w, int h, float out[], int stride) const;
 	// help function to generate the surface of disks
-	void leafyPreprocess(float number[]);
-	float leafyHeight(float x, float y, float number[]);
-	float icyHeight(float x, float z, ObjLibrary::Vector3 random_points[]);
-	float edgeFactor(float  x, float y);
+	void leafyPreprocess(float number[], Random& random) const;
+	float leafyHeight(float x, float y, float number[]) const;
+	float edgeFactor(float  x, float y) const;
+	void icyRow(int z, const IcyCones& cones, float row[]) const;
+	float icyHeight(float x, float z, const IcyCones& cones,
+		unsigned int begin, unsigned int end) const;
 	
 	/* member variables */
 	int m_diskType;
 	int m_heightmap_size;
 	int m_repeat;
+	uint64_t m_seed;
+	int m_tile_column;
+	int m_tile_row;
+	int m_tile_count;	// per side, 1 for a whole terrain
 
+	// the samples are stored with one extra column and row, copies
+	// of the first ones, so the corners of the last cells need no
+	// wrapping around
 	int indexing(int i, int j) const
 	{
-		return j * m_heightmap_size + i;
+		return j * (m_heightmap_size + 1) + i;
 	}
-	std::vector<float> m_heights;
-	ObjLibrary::DisplayList heightmap_list;
+	void padBorders(std::vector<float>& samples) const;
+	// the 3 corners of the triangle under (x, z) and their weights,
+	// in the order getHeight sums them
+	void getTriangle(float x, float z, int corners[3], float weights[3]) const;
+	// the height at fraction (x_frac, z_frac) of cell (i, k)
+	float getCellHeight(int i, int k, float x_frac, float z_frac) const;
+	bool raycastNode(const Ray& ray, int level, int column, int row,
+		float t0, float t1, float& hit) const;
+	bool raycastCell(const Ray& ray, int i, int k, float t0, float t1, float& hit) const;
+	// the t range in which the ray is over the cells from (x0, z0)
+	// to (x1, z1), clipped to [t0, t1]; false if it is empty
+	bool clipRay(const Ray& ray, int x0, int z0, int x1, int z1, float& t0, float& t1) const;
+	float getSample(int index) const
+	{
+		if (m_is_compact)
+			return m_compact_heights[index] * m_scale + m_offset;
+		else
+			return m_heights[index];
+	}
+	// the heights are built on demand, so they can change in
+	// const functions
+	mutable std::mutex m_mutex;
+	mutable std::atomic<bool> m_resident;
+	mutable std::vector<float> m_heights;
+	// the least and greatest height over each square of
+	// 2^l x 2^l cells, for levels l = 1 and up, until one square
+	// covers the heightmap: level l starts at m_pyramid_start[l - 1]
+	mutable std::vector<float> m_pyramid_min;
+	mutable std::vector<float> m_pyramid_max;
+	mutable std::vector<unsigned int> m_pyramid_start;
+	// in compact storage the heights are here instead, with one
+	// extra element so the vector gathers can read 4 bytes at a time
+	mutable bool m_is_compact;
+	mutable std::vector<int16_t> m_compact_heights;
+	mutable float m_scale;
+	mutable float m_offset;
+	mutable unsigned int m_last_used;
+	// the mesh vertices, on the GL side, or 0 until first drawn
+	GLuint m_vertex_buffer;
+	HeightsKernel m_heights_kernel;
+
+	static std::atomic<size_t> s_resident_bytes;
+	static unsigned int s_frame;
+	static bool s_is_compact;
+	static int s_icy_cone_count;
+	static std::vector<IndexBuffer> s_index_buffers;	// by disk type
 };
 
-#endif
\ No newline at end of file
+#endif
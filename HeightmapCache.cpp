@@ -0,0 +1,116 @@
+//
+//	HeightmapCache.cpp
+//
+
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include "HeightmapCache.h"
+#include "Random.h"
+
+#ifdef _WIN32
+	#include <direct.h>
+	#include <process.h>
+	#include <windows.h>  // needed for MoveFileEx
+#else
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+namespace {
+	const char MAGIC[4] = { 'H', 'M', 'C', '1' };
+}
+
+string HeightmapCache::s_directory;
+
+// the directory is created if it does not exist; an empty name
+// turns the cache off
+void HeightmapCache::setDirectory(const string& directory)
+{
+	s_directory = directory;
+	if (directory.empty())
+		return;
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+}
+
+uint64_t HeightmapCache::getKey(uint64_t seed, int disk_type, unsigned int generator_version,
+	unsigned int setting)
+{
+	return Random::mix(Random::mix(Random::mix(seed) +
+		(((uint64_t)generator_version << 32) | (unsigned int)disk_type)) + setting);
+}
+
+// the header is checked against the key and size, so a stale or
+// truncated file is a miss rather than wrong terrain
+bool HeightmapCache::load(uint64_t key, float heights[], unsigned int count)
+{
+	if (!isEnabled())
+		return false;
+	FILE* file = fopen(getFileName(key).c_str(), "rb");
+	if (file == NULL)
+		return false;
+
+	Header header;
+	bool is_valid = fread(&header, sizeof(header), 1, file) == 1 &&
+		memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+		header.count == count && header.key == key &&
+		fread(heights, sizeof(float), count, file) == count;
+	fclose(file);
+	return is_valid;
+}
+
+// the file is written under a temporary name and renamed, so a
+// reader never sees half of it; the name is per process and thread,
+// so two writers of the same key do not share a temporary file
+void HeightmapCache::store(uint64_t key, const float heights[], unsigned int count)
+{
+	if (!isEnabled())
+		return;
+	string file_name = getFileName(key);
+#ifdef _WIN32
+	unsigned int process_id = (unsigned int)_getpid();
+#else
+	unsigned int process_id = (unsigned int)getpid();
+#endif
+	char suffix[48];
+	snprintf(suffix, sizeof(suffix), ".%x.%llx.tmp", process_id,
+		(unsigned long long)hash<thread::id>()(this_thread::get_id()));
+	string temporary_name = file_name + suffix;
+	FILE* file = fopen(temporary_name.c_str(), "wb");
+	if (file == NULL)
+		return;
+
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.count = count;
+	header.key = key;
+	bool is_written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(heights, sizeof(float), count, file) == count;
+	if (fclose(file) != 0 || !is_written ||
+		!replaceFile(temporary_name, file_name))
+		remove(temporary_name.c_str());
+}
+
+// rename does not replace an existing file on Windows, and another
+// writer may have stored the same key first
+bool HeightmapCache::replaceFile(const string& from, const string& to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+string HeightmapCache::getFileName(uint64_t key)
+{
+	char name[24];
+	snprintf(name, sizeof(name), "%016llx.hm", (unsigned long long)key);
+	return s_directory + "/" + name;
+}
@@ -0,0 +1,40 @@
+//
+//	HeightmapCache.h
+//
+
+#ifndef HEIGHTMAPCACHE_H
+#define HEIGHTMAPCACHE_H
+
+#include <cstdint>
+#include <string>
+
+// a directory of generated heights, one file per heightmap, named
+// by a hash of everything the heights depend on (the disk's seed,
+// which comes from the world seed and the disk index, the disk type,
+// the generator version and any generator setting); the cache is off
+// until a directory is set, and must not be changed while
+// heightmaps are being built
+class HeightmapCache {
+public:
+	static void setDirectory(const std::string& directory);
+	static bool isEnabled() { return !s_directory.empty(); }
+	static uint64_t getKey(uint64_t seed, int disk_type, unsigned int generator_version,
+		unsigned int setting);
+	// false if the cache is off or has no heights for the key
+	static bool load(uint64_t key, float heights[], unsigned int count);
+	static void store(uint64_t key, const float heights[], unsigned int count);
+
+private:
+	struct Header {
+		char magic[4];
+		unsigned int count;
+		uint64_t key;
+	};
+	static std::string getFileName(uint64_t key);
+	// moves the file over any file already named to
+	static bool replaceFile(const std::string& from, const std::string& to);
+
+	static std::string s_directory;
+};
+
+#endif
@@ -0,0 +1,29 @@
+//
+//	HeightmapPool.cpp
+//
+
+#include <cassert>
+#include "HeightmapPool.h"
+#include "DiskType.h"
+#include "Random.h"
+
+using namespace std;
+
+// the heightmaps are only built when first used, so a type no disk
+// has costs nothing
+HeightmapPool::HeightmapPool(uint64_t seed, unsigned int variant_count)
+	: m_variant_count(variant_count)
+{
+	assert(variant_count > 0);
+	uint64_t pool_seed = Random::mix(seed);
+	for (int type = 0; type < DiskType::COUNT; type++)
+		for (unsigned int v = 0; v < variant_count; v++)
+			m_variants.push_back(make_shared<Heightmap>(type,
+				Random::getStreamSeed(pool_seed, type * variant_count + v)));
+}
+
+const shared_ptr<Heightmap>& HeightmapPool::get(int disk_type, uint64_t disk_seed) const
+{
+	unsigned int variant = (unsigned int)(Random::mix(disk_seed) % m_variant_count);
+	return m_variants[disk_type * m_variant_count + variant];
+}
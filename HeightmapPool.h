@@ -0,0 +1,31 @@
+//
+//	HeightmapPool.h
+//
+
+#ifndef HEIGHTMAPPOOL_H
+#define HEIGHTMAPPOOL_H
+
+#include <memory>
+#include <vector>
+#include "Heightmap.h"
+
+// a fixed number of shared heightmap variants per disk type; every
+// disk of a type uses one of them, picked by its seed, so the
+// terrain memory and display lists are bounded by
+// variant_count * DiskType::COUNT however many disks there are
+class HeightmapPool {
+public:
+	/* constructors and destructor */
+	HeightmapPool(uint64_t seed, unsigned int variant_count);
+
+	/* member functions */
+	const std::shared_ptr<Heightmap>& get(int disk_type, uint64_t disk_seed) const;
+
+private:
+	/* member variables */
+	unsigned int m_variant_count;
+	// variant v of type t is m_variants[t * m_variant_count + v]
+	std::vector<std::shared_ptr<Heightmap>> m_variants;
+};
+
+#endif
@@ -6,7 +6,12 @@
 // Keys 'w', 's', 'a', 'd' control the move
 // Keys 'up', 'down', 'left', 'right' control the direction
 // Key 'space' jumps and key 'r' reset position
+// Run with a world file (text or binary) to play that world, and a
+// seed after it to play the same terrain every time (the terrain is
+// then cached in HeightmapCache/), or with
+// "--convert in.txt out.dskb" to write a text world as a binary world
 
+#include <cstdlib>
 #include <sstream>
 #include "Sleep.h"
 #include "World.h"
@@ -16,6 +21,8 @@
 #include "ObjLibrary/SpriteFont.h"
 #include "ObjLibrary/ObjModel.h"
 #include "Enemy.h"
+#include "HeightmapCache.h"
+#include "WorldFile.h"
 
 using namespace std;
 using namespace ObjLibrary;
@@ -57,8 +64,9 @@ void initDisplay ()
 	glutPostRedisplay();
 }
 
-// this function load the model objects
-void init(string file_name)
+// this function load the model objects; a seed of 0 means a
+// random terrain
+void init(string file_name, uint64_t seed)
 {
 	for (int i = 0; i < KEY_COUNT; i++)
 		key_pressed[i] = false;
@@ -67,7 +75,14 @@ void init(string file_name)
 	skybox.load("Models/Skybox.obj");	// load the skybox object 
 	skybox_list = skybox.getDisplayList();
 
-	g_world.init(file_name);		// initial the world object
+	if (seed == 0)
+		g_world.init(file_name);		// initial the world object
+	else {
+		// the same terrain is generated every time, so keep it
+		HeightmapCache::setDirectory("HeightmapCache");
+		g_world.init(file_name, seed);
+	}
+	g_world.buildTerrain();		// the entities touch every disk right away
 	g_player.init(g_world);
 	g_pickup.init(g_world);
 	g_enemy.init(g_world);
@@ -182,6 +197,9 @@ void update ()
 			DeltaTime::physics_update++;
 			DeltaTime::update_lag -= DeltaTime::FIXED_DELTA_TIME * 1000.0f;
 		}
+		// the rings and bats keep their own disks resident by querying them
+		Vector3 focus = g_player.getPosition();
+		g_world.updateResidency(&focus, 1);
 		glutPostRedisplay();
 	}
 	else {
@@ -249,24 +267,27 @@ void display()
 
 	glLoadIdentity();
 
+	Vector3 camera;
 	if (key_pressed['o']) {	// switch the camera to overview camera by 'o' key
-		gluLookAt(100.0 + g_player.getPosition().x, 200.0, 10.0 + g_player.getPosition().z,  // (x, y, z) camera eye position
+		camera = Vector3(100.0 + g_player.getPosition().x, 200.0, 10.0 + g_player.getPosition().z);
+		gluLookAt(camera.x, camera.y, camera.z,  // (x, y, z) camera eye position
 			0.0 + g_player.getPosition().x, 0.8, 0.0 + g_player.getPosition().z,  // (x, y, z) camera look at position
 			0.0, 1.0, 0.0); // (x, y, z) camera up direction
 		g_pickup.drawMovement();
 	}
 	else {
-		gluLookAt(g_player.getPosition().x - 2.0 * g_player.getForward().x,
+		camera = Vector3(g_player.getPosition().x - 2.0 * g_player.getForward().x,
 			g_player.getPosition().y + 0.4,
-			g_player.getPosition().z - 2.0 * g_player.getForward().z,  // (x, y, z) camera eye position
+			g_player.getPosition().z - 2.0 * g_player.getForward().z);
+		gluLookAt(camera.x, camera.y, camera.z,  // (x, y, z) camera eye position
 			g_player.getPosition().x, g_player.getPosition().y, g_player.getPosition().z,  // (x, y, z) camera look at position
 			0.0, 1.0, 0.0); // (x, y, z) camera up direction
 		drawSkybox();		// draw a skybox
 	}
 
 	// camera is now set up - any drawing before here will display incorrectly
-	// draw all world disks
-	g_world.draw();
+	// draw all world disks, in less detail far from the camera
+	g_world.draw(camera);
 
 	g_pickup.draw();
 	g_enemy.draw();
@@ -284,6 +305,9 @@ void display()
 
 int main(int argc, char* argv[])
 {
+	if (argc == 4 && string(argv[1]) == "--convert")
+		return WorldFile::convert(argv[2], argv[3]) ? 0 : 1;
+
 	srand((unsigned int)time(NULL));
 	glutInitWindowSize(640, 480);
 	glutInitWindowPosition(0, 0);
@@ -299,7 +323,14 @@ int main(int argc, char* argv[])
 	glutReshapeFunc(&reshape);
 	glutDisplayFunc(&display);
 
-	init("Worlds/Basic.txt");
+	// glutInit has removed its own arguments
+	uint64_t seed = 0;
+	if (argc > 2)
+		seed = strtoull(argv[2], NULL, 10);
+	if (argc > 1)
+		init(argv[1], seed);
+	else
+		init("Worlds/Basic.txt", seed);
 	//init("Worlds/Dense.txt");
 	//init("Worlds/Icy.txt");
 	//init("Worlds/Leafy.txt");
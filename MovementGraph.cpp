@@ -9,12 +9,17 @@
 #include "UpdatablePriorityQueue.h"
 #include <stack>
 #include <algorithm>
+#include <cmath>
 
 using namespace std;
 using namespace ObjLibrary;
 namespace {
 	const unsigned int NEVER_REACHED = 999999999;
 	const float MAX_COST = 99999.9f;
+	// the random picks of a source and goal before a ring gives up
+	// and stays where it is, as it must in a world without 2 nodes
+	// that are connected and at least 3 nodes apart
+	const unsigned int MAX_PATH_TRIES = 100;
 
 	bool display_sphere = false;
 	unsigned int meeting_node_id_display;
@@ -37,15 +42,85 @@ void MovementGraph::init(const World& world)
 	for (unsigned int i = 0; i < disk_count; i++)
 		disk_node_list.push_back({});
 	
-	for (unsigned int i = 0; i < disk_count - 1; i++) {
-		const Disk& disk_i = world.getDisk(i);
-		for (unsigned int j = i + 1; j < disk_count; j++) {
-			const Disk& disk_j = world.getDisk(j);
-			double distance = disk_i.getPosition().getDistance(disk_j.getPosition());
-			if (distance <= disk_i.getRadius() + disk_j.getRadius() + 0.01)
-				addToGraph(world, i, j);
+	// the world's grid finds the touching disks in index order,
+	// so the pairs are added in the same order as by testing them all
+	vector<unsigned int> touching;
+	for (unsigned int i = 0; i + 1 < disk_count; i++) {
+		world.findTouchingDisks(i, 0.01, touching);
+		for (unsigned int k = 0; k < touching.size(); k++)
+			if (touching[k] > i)
+				addToGraph(world, i, touching[k]);
+	}
+	if (disk_link_mode == RING_AND_HUB)
+		for (unsigned int i = 0; i < disk_count; i++)
+			addRingAndHub(world.getDisk(i), i);
+	compactGraph();
+}
+
+// the links of each node are copied out in the order they were
+// added, so the searches expand them in the same order as before
+void MovementGraph::compactGraph()
+{
+	unsigned int node_count = node_array.size();
+	link_offsets.assign(1, 0);
+	link_targets.clear();
+	link_weights.clear();
+	node_x.resize(node_count);
+	node_y.resize(node_count);
+	node_z.resize(node_count);
+	node_disk_ids.resize(node_count);
+	for (unsigned int i = 0; i < node_count; i++) {
+		const Node& node = node_array[i];
+		for (unsigned int j = 0; j < node.neighbor.size(); j++) {
+			link_targets.push_back(node.neighbor[j].node_id);
+			link_weights.push_back(node.neighbor[j].weight);
 		}
+		link_offsets.push_back(link_targets.size());
+		node_x[i] = (float)node.position.x;
+		node_y[i] = (float)node.position.y;
+		node_z[i] = (float)node.position.z;
+		node_disk_ids[i] = node.disk_id;
 	}
+	vector<Node>().swap(node_array);
+	vector<NodeList>().swap(disk_node_list);
+	initComponents();
+}
+
+// the components are labelled by a depth-first walk from each node
+// not yet labelled, then the nodes are sorted by component (a
+// counting sort, so each component keeps them in node order)
+void MovementGraph::initComponents()
+{
+	unsigned int node_count = getNodeCount();
+	node_component.assign(node_count, NEVER_REACHED);
+	unsigned int component_count = 0;
+	vector<unsigned int> to_visit;
+	for (unsigned int i = 0; i < node_count; i++) {
+		if (node_component[i] != NEVER_REACHED)
+			continue;
+		node_component[i] = component_count;
+		to_visit.push_back(i);
+		while (!to_visit.empty()) {
+			unsigned int node_id = to_visit.back();
+			to_visit.pop_back();
+			for (unsigned int j = link_offsets[node_id]; j < link_offsets[node_id + 1]; j++)
+				if (node_component[link_targets[j]] == NEVER_REACHED) {
+					node_component[link_targets[j]] = component_count;
+					to_visit.push_back(link_targets[j]);
+				}
+		}
+		component_count++;
+	}
+
+	component_offsets.assign(component_count + 1, 0);
+	for (unsigned int i = 0; i < node_count; i++)
+		component_offsets[node_component[i] + 1]++;
+	for (unsigned int c = 0; c < component_count; c++)
+		component_offsets[c + 1] += component_offsets[c];
+	vector<unsigned int> next_slot(component_offsets.begin(), component_offsets.end() - 1);
+	component_nodes.resize(node_count);
+	for (unsigned int i = 0; i < node_count; i++)
+		component_nodes[next_slot[node_component[i]]++] = i;
 }
 
 // following 6 functions are same in the suggested approach
@@ -63,6 +138,13 @@ void MovementGraph::addToGraph(const World& world, const unsigned int& i, const
 		disk_i.getDiskType(), disk_j.getDiskType());
 	addLink(node_i_id, node_j_id, weight_ij);
 
+	// the nodes on one disk are linked once they are all known
+	if (disk_link_mode == RING_AND_HUB) {
+		disk_node_list[i].add(node_i_id);
+		disk_node_list[j].add(node_j_id);
+		return;
+	}
+
 	for (unsigned int k = 0; k < disk_node_list[i].node_list.size(); k++) {
 		unsigned int node_k_id = disk_node_list[i].node_list[k];
 		float weight_ik = calculateWeightSameDisks(node_i_id, node_k_id, disk_i);
@@ -124,25 +206,71 @@ Vector3 MovementGraph::calculateNodePosition(const Disk& disk_i, const Disk& dis
 	return center_i + u * distance;
 }
 
+// the nodes of a disk are sorted by their angle around its center
+// and each is linked to the next, then a hub at the center is linked
+// to each of them when a ring alone would leave long ways around
+void MovementGraph::addRingAndHub(const Disk& disk, unsigned int disk_id)
+{
+	const vector<unsigned int>& node_list = disk_node_list[disk_id].node_list;
+	if (node_list.size() < 2)
+		return;
+
+	Vector3 center = disk.getPosition();
+	vector<pair<double, unsigned int>> by_angle;
+	for (unsigned int k = 0; k < node_list.size(); k++) {
+		Vector3 offset = node_array[node_list[k]].position - center;
+		by_angle.push_back({ atan2(offset.z, offset.x), node_list[k] });
+	}
+	sort(by_angle.begin(), by_angle.end());
+
+	if (by_angle.size() == 2) {
+		addLink(by_angle[0].second, by_angle[1].second,
+			calculateWeightSameDisks(by_angle[0].second, by_angle[1].second, disk));
+		return;
+	}
+	for (unsigned int k = 0; k < by_angle.size(); k++) {
+		unsigned int node_k_id = by_angle[k].second;
+		unsigned int node_next_id = by_angle[(k + 1) % by_angle.size()].second;
+		addLink(node_k_id, node_next_id, calculateWeightSameDisks(node_k_id, node_next_id, disk));
+	}
+
+	// three nodes in a ring are already all linked
+	if (by_angle.size() > 3) {
+		unsigned int hub_id = addNode(center, disk_id);
+		for (unsigned int k = 0; k < by_angle.size(); k++)
+			addLink(hub_id, by_angle[k].second, calculateWeightBetweenDisks(hub_id,
+				by_angle[k].second, disk.getDiskType(), disk.getDiskType()));
+	}
+}
+
 // the following three functions is common sub-function for both search
 
 void MovementGraph::pathFinding()
 {
 	unsigned int source_id;
 	unsigned int goal_id;
-	initializeSourceAndGoal(source_id, goal_id);
-	AStarSearch(source_id, goal_id);
-	//MMSearch(source_id, goal_id);
+	if (initializeSourceAndGoal(source_id, goal_id)) {
+		AStarSearch(source_id, goal_id);
+		//MMSearch(source_id, goal_id);
+		return;
+	}
+
+	// a ring is placed at the start of its first path, so without
+	// a goal it is given a path of just its source, and stays there
+	while (!path.empty())
+		path.pop();
+	if (getNodeCount() > 0)
+		path.push(source_id);
 }
 
 void MovementGraph::updatePath(const unsigned int& source_id)
 {
 	unsigned int goal_id;
-	bool initialize_source_and_goal = false;
-	while (!initialize_source_and_goal) {
-		goal_id = random1(node_array.size());
-		assert(goal_id < node_array.size());
-		initialize_source_and_goal = checkAtLeast3NodesAway(source_id, goal_id);
+	if (!pickGoal(source_id, goal_id, MAX_PATH_TRIES)) {
+		// the ring stays where it is
+		while (!path.empty())
+			path.pop();
+		return;
 	}
 	AStarSearch(source_id, goal_id);
 	//MMSearch(source_id, goal_id);
@@ -156,40 +284,105 @@ void MovementGraph::displayWhen(bool is_true)
 
 // the following two functions initialize array and node for both searches
 
-void MovementGraph::initializeSourceAndGoal(unsigned int& source_id, unsigned int& goal_id)
+bool MovementGraph::initializeSourceAndGoal(unsigned int& source_id, unsigned int& goal_id)
 {
-	bool initialize_source_and_goal = false;
-	while (!initialize_source_and_goal) {
-		source_id = random1(node_array.size());
-		assert(source_id < node_array.size());
-		goal_id = random1(node_array.size());
-		assert(goal_id < node_array.size());
-		initialize_source_and_goal = checkAtLeast3NodesAway(source_id, goal_id);
+	source_id = 0;
+	if (getNodeCount() == 0)
+		return false;
+	for (unsigned int i = 0; i < MAX_PATH_TRIES; i++) {
+		source_id = random1(getNodeCount());
+		assert(source_id < getNodeCount());
+		if (pickGoal(source_id, goal_id, 1))
+			return true;
 	}
+	return false;
 }
 
-vector<MovementGraph::SearchData>
-MovementGraph::initializeSearchData(const unsigned int& source_id,
-									const unsigned int& goal_id,
-									Search search_type)
+// the goal is drawn from the source's component, so the search
+// always reaches it; in a connected graph that is every node, and
+// the draws are the same as picking from the whole graph
+bool MovementGraph::pickGoal(unsigned int source_id, unsigned int& goal_id,
+	unsigned int try_count)
 {
-	Vector3 goal = node_array[goal_id].position;
-	vector<SearchData> search_data_array;
-	for (unsigned int i = 0; i < node_array.size(); i++) {
-		search_data_array.push_back({});
-		search_data_array[i].best_previous_node_id = NEVER_REACHED;
-		search_data_array[i].best_cost_to_here = MAX_COST;
-		search_data_array[i].heuristic = (float)node_array[i].position.getDistance(goal);
-		search_data_array[i].priority = updatePriority(search_data_array[i].best_cost_to_here,
-			search_data_array[i].heuristic, search_type);
+	if (source_id >= getNodeCount())
+		return false;
+	unsigned int component = node_component[source_id];
+	unsigned int begin = component_offsets[component];
+	unsigned int size = component_offsets[component + 1] - begin;
+	for (unsigned int i = 0; i < try_count; i++) {
+		goal_id = component_nodes[begin + random1(size)];
+		assert(goal_id < getNodeCount());
+		if (checkAtLeast3NodesAway(source_id, goal_id))
+			return true;
+	}
+	return false;
+}
+
+// the buffers are only sized on the first search, and the stamps
+// are only cleared when the generation counter wraps around
+void MovementGraph::startSearch(SearchContext& context, unsigned int source_id,
+	unsigned int goal_id, Search search_type)
+{
+	if (context.search_data.size() != getNodeCount()) {
+		context.search_data.resize(getNodeCount());
+		context.reached_generation.assign(getNodeCount(), 0);
+		context.closed_generation.assign(getNodeCount(), 0);
+		context.open_list.setCapacity(getNodeCount());
+		context.generation = 0;
+	}
+	context.generation++;
+	if (context.generation == 0) {
+		fill(context.reached_generation.begin(), context.reached_generation.end(), 0);
+		fill(context.closed_generation.begin(), context.closed_generation.end(), 0);
+		context.generation = 1;
 	}
+	context.open_list.clear();
+	context.goal_id = goal_id;
+	context.search_type = search_type;
 
 	// initialize the source_id
-	search_data_array[source_id].best_previous_node_id = source_id;
-	search_data_array[source_id].best_cost_to_here = 0.0f;
-	search_data_array[source_id].priority = updatePriority(search_data_array[source_id].best_cost_to_here,
-		search_data_array[source_id].heuristic, search_type);
-	return search_data_array;
+	SearchData& source = reachNode(context, source_id);
+	source.best_previous_node_id = source_id;
+	source.best_cost_to_here = 0.0f;
+	source.priority = updatePriority(source.best_cost_to_here, source.heuristic, search_type);
+}
+
+// a node's search data is set up, heuristic included, the first
+// time the current search reaches it
+MovementGraph::SearchData& MovementGraph::reachNode(SearchContext& context, unsigned int node_id)
+{
+	SearchData& data = context.search_data[node_id];
+	if (context.reached_generation[node_id] != context.generation) {
+		context.reached_generation[node_id] = context.generation;
+		double dx = (double)node_x[node_id] - node_x[context.goal_id];
+		double dy = (double)node_y[node_id] - node_y[context.goal_id];
+		double dz = (double)node_z[node_id] - node_z[context.goal_id];
+		data.best_previous_node_id = NEVER_REACHED;
+		data.best_cost_to_here = MAX_COST;
+		data.heuristic = (float)sqrt(dx * dx + dy * dy + dz * dz);
+		data.priority = updatePriority(data.best_cost_to_here, data.heuristic, context.search_type);
+	}
+	return data;
+}
+
+// the spheres are drawn for every node, so the nodes the search
+// never reached are filled in as it would have set them up
+void MovementGraph::copySearchData(const SearchContext& context,
+	vector<SearchData>& search_data_display) const
+{
+	search_data_display = context.search_data;
+	for (unsigned int i = 0; i < getNodeCount(); i++) {
+		if (context.reached_generation[i] == context.generation)
+			continue;
+		double dx = (double)node_x[i] - node_x[context.goal_id];
+		double dy = (double)node_y[i] - node_y[context.goal_id];
+		double dz = (double)node_z[i] - node_z[context.goal_id];
+		search_data_display[i].best_previous_node_id = NEVER_REACHED;
+		search_data_display[i].best_cost_to_here = MAX_COST;
+		search_data_display[i].heuristic = (float)sqrt(dx * dx + dy * dy + dz * dz);
+		search_data_display[i].priority = updatePriority(MAX_COST,
+			search_data_display[i].heuristic, context.search_type);
+	}
 }
 
 // the following two functions verify nodes
@@ -198,27 +391,25 @@ bool MovementGraph::checkAtLeast3NodesAway(const unsigned int& source_id, const
 {
 	if (source_id == goal_id)
 		return false;
-	for (unsigned int j = 0; j < node_array[goal_id].neighbor.size(); j++) {
-		if (source_id == node_array[goal_id].neighbor[j].node_id)
+	for (unsigned int j = link_offsets[goal_id]; j < link_offsets[goal_id + 1]; j++) {
+		if (source_id == link_targets[j])
 			return false;
 	}
-	for (unsigned int i = 0; i < node_array[source_id].neighbor.size(); i++) {
-		if (node_array[source_id].neighbor[i].node_id == goal_id)
+	for (unsigned int i = link_offsets[source_id]; i < link_offsets[source_id + 1]; i++) {
+		if (link_targets[i] == goal_id)
 			return false;
-		for (unsigned int j = 0; j < node_array[goal_id].neighbor.size(); j++) {
-			if (node_array[source_id].neighbor[i].node_id == node_array[goal_id].neighbor[j].node_id)
+		for (unsigned int j = link_offsets[goal_id]; j < link_offsets[goal_id + 1]; j++) {
+			if (link_targets[i] == link_targets[j])
 				return false;
 		}
 	}
 	return true;
 }
 
-bool MovementGraph::isNodeInCloseList(unsigned int node_id, std::vector<unsigned int>& close_list)
+bool MovementGraph::isReached(const SearchContext& context, unsigned int node_id) const
 {
-	for (unsigned int i = 0; i < close_list.size(); i++)
-		if (node_id == close_list[i])
-			return true;
-	return false;
+	return context.reached_generation[node_id] == context.generation &&
+		context.search_data[node_id].best_previous_node_id != NEVER_REACHED;
 }
 
 // the following function outputs all the adjacent nodes from the current node
@@ -226,37 +417,33 @@ bool MovementGraph::isNodeInCloseList(unsigned int node_id, std::vector<unsigned
 // and calculate their priority
 // and insert or update in the open list
 // and insert to the close list
-void MovementGraph::splitNode(std::vector<SearchData>& search_data_array,
-	UpdatablePriorityQueue<float>& open_list,
-	std::vector<unsigned int>& close_list,
-	Search search_type)
+void MovementGraph::splitNode(SearchContext& context)
 {
+	UpdatablePriorityQueue<float>& open_list = context.open_list;
+
 	// delete the current node from the open list
 	unsigned int current_node_id = open_list.peekAndDequeue();
+	const float current_cost = context.search_data[current_node_id].best_cost_to_here;
 
 	//outputs all the adjacent nodes from the current node
-	for (unsigned int i = 0; i < node_array[current_node_id].neighbor.size(); i++) {
-		const unsigned int node_id = node_array[current_node_id].neighbor[i].node_id;
-		const float weight = node_array[current_node_id].neighbor[i].weight;
+	for (unsigned int i = link_offsets[current_node_id]; i < link_offsets[current_node_id + 1]; i++) {
+		const unsigned int node_id = link_targets[i];
+		const float weight = link_weights[i];
 
 		// check whether the neighbor is in the close list
-		bool is_in_close_list = false;
-		for (unsigned int j = 0; j < close_list.size(); j++)
-			if (node_id == close_list[j])
-				is_in_close_list = true;
-		if (!is_in_close_list) {
+		if (!isClosed(context, node_id)) {
 			// update the priority of the neighbor
-			float old_cost = search_data_array[node_id].best_cost_to_here;
-			float new_cost = search_data_array[current_node_id].best_cost_to_here + weight;
+			SearchData& neighbor = reachNode(context, node_id);
+			float old_cost = neighbor.best_cost_to_here;
+			float new_cost = current_cost + weight;
 			if (new_cost < old_cost) {
-				search_data_array[node_id].best_previous_node_id = current_node_id;
-				search_data_array[node_id].best_cost_to_here = new_cost;
-				search_data_array[node_id].priority =
-					updatePriority(new_cost, search_data_array[node_id].heuristic, search_type);
+				neighbor.best_previous_node_id = current_node_id;
+				neighbor.best_cost_to_here = new_cost;
+				neighbor.priority = updatePriority(new_cost, neighbor.heuristic, context.search_type);
 			}
 			// insert the neighbor to the open list
 			// or update the priority if the lower one has found
-			float new_priority = search_data_array[node_id].priority;
+			float new_priority = neighbor.priority;
 			if (!open_list.isEnqueued(node_id))
 				open_list.enqueue(node_id, new_priority);
 			else if (open_list.getPriority(node_id) > new_priority)
@@ -264,11 +451,11 @@ void MovementGraph::splitNode(std::vector<SearchData>& search_data_array,
 		}
 	}
 	// insert to the close list
-	close_list.push_back(current_node_id);
+	context.closed_generation[current_node_id] = context.generation;
 }
 
 // select the update priority method
-float MovementGraph::updatePriority(float cost, float heuristic, Search search_type)
+float MovementGraph::updatePriority(float cost, float heuristic, Search search_type) const
 {
 	if (search_type == AStar)
 		return cost + heuristic;
@@ -282,9 +469,9 @@ void MovementGraph::AStarSearch(const unsigned int& source_id,
 	const unsigned int& goal_id)
 {
 	// initialize the arrays
-	vector<SearchData> search_data_array = initializeSearchData(source_id, goal_id, AStar);
-	UpdatablePriorityQueue<float> open_list(node_array.size());
-	vector<unsigned int> close_list;
+	startSearch(forward_search, source_id, goal_id, AStar);
+	UpdatablePriorityQueue<float>& open_list = forward_search.open_list;
+	const vector<SearchData>& search_data_array = forward_search.search_data;
 
 	// insert the starting node to the open list
 	open_list.enqueue(source_id, search_data_array[source_id].priority);
@@ -294,22 +481,27 @@ void MovementGraph::AStarSearch(const unsigned int& source_id,
 	while (!open_list.isQueueEmpty()) {
 		if (open_list.peek() == goal_id)
 			break;
-		splitNode(search_data_array, open_list, close_list, AStar);
+		splitNode(forward_search);
 	}
 
+	// clear up the path stack
+	while (!path.empty())
+		path.pop();
+
+	// the search data of a node this search never reached is left
+	// over from an earlier search; with disks that do not all touch
+	// the goal may not be reachable, and then the path is empty
+	if (!isReached(forward_search, goal_id))
+		return;
+
 	// if the ring is ring0, copy the search data which will display
 	// as spheres later
 	if (display_sphere) {
-		search_data_from_source_display.clear();
-		search_data_from_source_display = search_data_array;
+		copySearchData(forward_search, search_data_from_source_display);
 		max_priority_from_source = search_data_array[goal_id].priority;
 		min_priority_from_source = search_data_array[source_id].priority;
 		display_sphere = false;
 	}
-
-	// clear up the path stack
-	while (!path.empty())
-		path.pop();
 	unsigned int current = goal_id;
 
 	// fill up the stack from the destination node
@@ -322,11 +514,9 @@ void MovementGraph::AStarSearch(const unsigned int& source_id,
 
 void MovementGraph::drawAStarSphere() const
 {
-	for (unsigned int k = 0; k < node_array.size(); k++) {
+	for (unsigned int k = 0; k < getNodeCount(); k++) {
 		glPushMatrix();
-		glTranslatef((GLfloat)node_array[k].position.x,
-			(GLfloat)node_array[k].position.y,
-			(GLfloat)node_array[k].position.z);
+		glTranslatef(node_x[k], node_y[k], node_z[k]);
 		// draw the starting node
 		if (search_data_from_source_display[k].best_previous_node_id == k) {
 			glColor3f(0.0f, 1.0f, 1.0f);
@@ -350,13 +540,13 @@ void MovementGraph::drawAStarSphere() const
 void MovementGraph::MMSearch(const unsigned int& source_id, const unsigned int& goal_id)
 {
 	// initialize all arrays
-	vector<SearchData> search_data_from_source = initializeSearchData(source_id, goal_id, MM);
-	vector<SearchData> search_data_from_goal = initializeSearchData(goal_id, source_id, MM);
-	UpdatablePriorityQueue<float> open_list_from_source(node_array.size());
-	UpdatablePriorityQueue<float> open_list_from_goal(node_array.size());
-	vector<unsigned int> close_list_from_source;
-	vector<unsigned int> close_list_from_goal;
-	unsigned int meeting_node_id;
+	startSearch(forward_search, source_id, goal_id, MM);
+	startSearch(backward_search, goal_id, source_id, MM);
+	UpdatablePriorityQueue<float>& open_list_from_source = forward_search.open_list;
+	UpdatablePriorityQueue<float>& open_list_from_goal = backward_search.open_list;
+	const vector<SearchData>& search_data_from_source = forward_search.search_data;
+	const vector<SearchData>& search_data_from_goal = backward_search.search_data;
+	unsigned int meeting_node_id = NEVER_REACHED;
 
 	// insert the starting node to the open list
 	open_list_from_source.enqueue(source_id, search_data_from_source[source_id].priority);
@@ -365,31 +555,33 @@ void MovementGraph::MMSearch(const unsigned int& source_id, const unsigned int&
 	// the while loop will stop when the destination has been reached
 	// or the open list is emtpy
 	while (!open_list_from_source.isQueueEmpty() && !open_list_from_goal.isQueueEmpty()) {
-		if (isNodeInCloseList(open_list_from_source.peek(), close_list_from_goal)) {
+		if (isClosed(backward_search, open_list_from_source.peek())) {
 			meeting_node_id = open_list_from_source.peek();
 			break;
 		}
-		else if (isNodeInCloseList(open_list_from_goal.peek(), close_list_from_source)) {
+		else if (isClosed(forward_search, open_list_from_goal.peek())) {
 			meeting_node_id = open_list_from_goal.peek();
 			break;
 		}
 
 		// selection current node from the lower priority head of two open lists
 		if (open_list_from_source.peekPriority() < open_list_from_goal.peekPriority())
-			splitNode(search_data_from_source, open_list_from_source,
-				close_list_from_source, MM);
+			splitNode(forward_search);
 		else
-			splitNode(search_data_from_goal, open_list_from_goal,
-				close_list_from_goal, MM);
+			splitNode(backward_search);
 	}
 
 	// clear up the path stack
 	while (!path.empty())
 		path.pop();
 
+	// an open list ran out first, so the two nodes are not connected
+	if (meeting_node_id == NEVER_REACHED)
+		return;
+
 	// fill up the invert path stack
 	// from the meeting node to the destination node
-	std::stack<unsigned int> invert_path;
+	assert(invert_path.empty());
 	unsigned int current = meeting_node_id;
 	while (current != goal_id) {
 		invert_path.push(current);
@@ -416,13 +608,11 @@ void MovementGraph::MMSearch(const unsigned int& source_id, const unsigned int&
 	// if the ring is ring0, copy the search data which will display
 	// as spheres later
 	if (display_sphere) {
-		search_data_from_source_display.clear();
-		search_data_from_source_display = search_data_from_source;
+		copySearchData(forward_search, search_data_from_source_display);
 		max_priority_from_source = search_data_from_source[meeting_node_id].priority;
 		min_priority_from_source = search_data_from_source[source_id].priority;
 
-		search_data_from_goal_display.clear();
-		search_data_from_goal_display = search_data_from_goal;
+		copySearchData(backward_search, search_data_from_goal_display);
 		max_priority_from_goal = search_data_from_goal[meeting_node_id].priority;
 		min_priority_from_goal = search_data_from_goal[goal_id].priority;
 
@@ -433,11 +623,9 @@ void MovementGraph::MMSearch(const unsigned int& source_id, const unsigned int&
 
 void MovementGraph::drawMMSphere() const
 {
-	for (unsigned int k = 0; k < node_array.size(); k++) {
+	for (unsigned int k = 0; k < getNodeCount(); k++) {
 		glPushMatrix();
-		glTranslatef((GLfloat)node_array[k].position.x,
-			(GLfloat)node_array[k].position.y,
-			(GLfloat)node_array[k].position.z);
+		glTranslatef(node_x[k], node_y[k], node_z[k]);
 
 		// draw the starting node
 		if (search_data_from_source_display[k].best_previous_node_id == k) {
@@ -471,18 +659,15 @@ void MovementGraph::drawPath() const
 {
 	const float LINE_ABOVE = 1.0f;
 
-	for (unsigned int i = 0; i < node_array.size(); i++) {
-		for (unsigned int j = 0; j < node_array[i].neighbor.size(); j++) {
-			unsigned int target = node_array[i].neighbor[j].node_id;
-			float weight = node_array[i].neighbor[j].weight;
+	for (unsigned int i = 0; i < getNodeCount(); i++) {
+		for (unsigned int j = link_offsets[i]; j < link_offsets[i + 1]; j++) {
+			unsigned int target = link_targets[j];
+			float weight = link_weights[j];
 
 			glColor3f(1.0f, 1.0f - weight / 150.0f, 0.0f);
 			glBegin(GL_LINE_STRIP);
-			glVertex3d(node_array[i].position.x,
-				node_array[i].position.y + LINE_ABOVE, node_array[i].position.z);
-			glVertex3d(node_array[target].position.x,
-				node_array[target].position.y + LINE_ABOVE, 
-				node_array[target].position.z);
+			glVertex3f(node_x[i], node_y[i] + LINE_ABOVE, node_z[i]);
+			glVertex3f(node_x[target], node_y[target] + LINE_ABOVE, node_z[target]);
 			glEnd();
 		}
 	}
@@ -494,17 +679,17 @@ void MovementGraph::drawSphere() const
 	//drawMMSphere();
 }
 
-Vector3 MovementGraph::getPosition(unsigned int node_id)
+Vector3 MovementGraph::getPosition(unsigned int node_id) const
 {
-	return node_array[node_id].position;
+	return Vector3(node_x[node_id], node_y[node_id], node_z[node_id]);
 }
 
-unsigned int MovementGraph::getDiskId(unsigned int node_id)
+unsigned int MovementGraph::getDiskId(unsigned int node_id) const
 {
-	return node_array[node_id].disk_id;
+	return node_disk_ids[node_id];
 }
 
-stack<unsigned int> MovementGraph::getPath()
+const MovementGraph::Path& MovementGraph::getPath() const
 {
 	return path;
 }
\ No newline at end of file
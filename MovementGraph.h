@@ -47,8 +47,31 @@ private:
 	// create a enum to tell the function which search methor are used
 	enum Search { AStar, MM };
 
+	// the buffers of one search direction, kept from one search to
+	// the next; an entry of search_data only belongs to the current
+	// search if its reached stamp is the current generation, so a new
+	// search starts without touching the whole graph
+	struct SearchContext {
+		std::vector<SearchData> search_data;
+		std::vector<unsigned int> reached_generation;
+		std::vector<unsigned int> closed_generation;
+		UpdatablePriorityQueue<float> open_list;
+		unsigned int generation = 0;
+		unsigned int goal_id = 0;
+		Search search_type = AStar;
+	};
+
 	// initialize the class when the game starts
 public:
+	// a path from its first node (at the top) to its last
+	typedef std::stack<unsigned int, std::vector<unsigned int>> Path;
+	// how the nodes on one disk are linked to each other: every
+	// pair of them, or each to the next by angle plus a node at
+	// the disk's center linked to all of them
+	enum DiskLinks { CLIQUE, RING_AND_HUB };
+	// opt-in, before init: RING_AND_HUB keeps the links per disk
+	// linear in its node count (CLIQUE, the default)
+	void setDiskLinks(DiskLinks disk_links) { disk_link_mode = disk_links; }
 	void init(const World& world);
 
 	// generate movement graph when the game initializes
@@ -71,6 +94,11 @@ private:
 		const Disk& disk_i);
 	ObjLibrary::Vector3 calculateNodePosition(const Disk& disk_i,
 		const Disk& disk_j);
+	void addRingAndHub(const Disk& disk, unsigned int disk_id);
+	// pack the finished graph into the flat arrays the searches use
+	void compactGraph();
+	void initComponents();
+	unsigned int getNodeCount() const { return node_disk_ids.size(); }
 
 
 	// common functions for both search algorithm
@@ -80,22 +108,31 @@ public:
 	void displayWhen(bool is_true);		// label the ring 0 display when i = 0
 private:
 	// initialize arrays and variable
-	void initializeSourceAndGoal(unsigned int& source_id,
+	bool initializeSourceAndGoal(unsigned int& source_id,
 		unsigned int& goal_id);
-	std::vector<SearchData> initializeSearchData(const unsigned int& source_id,
-		const unsigned int& goal_id, Search search_type);
+	// a random node connected to source_id, or false if try_count
+	// draws find none at least 3 nodes away
+	bool pickGoal(unsigned int source_id, unsigned int& goal_id,
+		unsigned int try_count);
+	void startSearch(SearchContext& context, unsigned int source_id,
+		unsigned int goal_id, Search search_type);
+	SearchData& reachNode(SearchContext& context, unsigned int node_id);
+	void copySearchData(const SearchContext& context,
+		std::vector<SearchData>& search_data_display) const;
 
 	// verification
 	bool checkAtLeast3NodesAway(const unsigned int& source_id,
 		const unsigned int& goal_id);
-	bool isNodeInCloseList(unsigned int node_id, std::vector<unsigned int>& close_list);
+	// whether the current search has found a way to node_id
+	bool isReached(const SearchContext& context, unsigned int node_id) const;
+	bool isClosed(const SearchContext& context, unsigned int node_id) const
+	{
+		return context.closed_generation[node_id] == context.generation;
+	}
 
 	// sub-operation
-	void splitNode(std::vector<SearchData>& search_data_array,
-		UpdatablePriorityQueue<float>& open_list,
-		std::vector<unsigned int>& close_list,
-		Search search_type);
-	float updatePriority(float cost, float heuristic, Search search_type);
+	void splitNode(SearchContext& context);
+	float updatePriority(float cost, float heuristic, Search search_type) const;
 	
 	// functions for A Star search 
 	void AStarSearch(const unsigned int& source_id,
@@ -111,16 +148,42 @@ private:
 public:
 	void drawPath() const;
 	void drawSphere() const;
-	ObjLibrary::Vector3 getPosition(unsigned int node_id);
-	unsigned int getDiskId(unsigned int node_id);
-	std::stack<unsigned int> getPath();
+	ObjLibrary::Vector3 getPosition(unsigned int node_id) const;
+	unsigned int getDiskId(unsigned int node_id) const;
+	const Path& getPath() const;
 	
 	// member variables
 private:
-	std::stack<unsigned int> path;
+	Path path;
+	DiskLinks disk_link_mode = CLIQUE;
+	// the graph while init builds it, emptied by compactGraph
 	std::vector<Node> node_array;
 	std::vector<NodeList> disk_node_list;
 
+	// the finished graph in compressed sparse rows: the links of
+	// node i are in slots link_offsets[i] to link_offsets[i + 1] - 1
+	// of link_targets and link_weights, and the node positions and
+	// disks are in arrays of their own
+	std::vector<unsigned int> link_offsets;
+	std::vector<unsigned int> link_targets;
+	std::vector<float> link_weights;
+	std::vector<float> node_x;
+	std::vector<float> node_y;
+	std::vector<float> node_z;
+	std::vector<unsigned int> node_disk_ids;
+	// the nodes that can reach each other: component c has the
+	// nodes in slots component_offsets[c] to
+	// component_offsets[c + 1] - 1 of component_nodes, in node order
+	std::vector<unsigned int> node_component;
+	std::vector<unsigned int> component_offsets;
+	std::vector<unsigned int> component_nodes;
+
+	// the searches reuse these, so replanning does not allocate
+	SearchContext forward_search;
+	SearchContext backward_search;
+	// MMSearch builds the goal half of its path in here
+	Path invert_path;
+
 	// store the information for ring0
 	std::vector<SearchData> search_data_from_source_display;
 	std::vector<SearchData> search_data_from_goal_display;
@@ -7,25 +7,38 @@
 
 #include <ctime>
 #include <cmath>
+#include <vector>
 #include "GetGlut.h"
 #include "ObjLibrary/Vector2.h"
+#include "Random.h"
 
 #define PI 3.14159265f
 
 class NoiseField {
 public:
 	/* constructors and destructor */
-	NoiseField(float g, float a);
+	NoiseField(float g, float a, Random& random);
 	NoiseField() : grid_size(0.0f), amplitude(0.0f) {}
 	~NoiseField() = default;
 
 	/* member functions */
 	float valueNoise(float x, float y);
 	float perlinNoise(float x, float y);
+	// perlinNoise at x0 + i * step, z0 + j * step into out[j * w + i],
+	// with the same results
+	void fillGrid(float* out, int w, int h, float x0, float z0, float step);
+	// the pseudorandom hashes of a w x h block of lattice points,
+	// from (x0, z0)
+	void fillHashes(int x0, int z0, int w, int h, unsigned int hashes[]);
+	float getGridSize() const { return grid_size; }
+	float getAmplitude() const { return amplitude; }
+	// the smooth step from 0 to 1 between lattice points
+	static float fade(float n);
 private:
+	void hashRow(int x0, int y, int count, unsigned int hashes[]);
 	unsigned int pseudorandom(int x, int y);
-	float fade(float n);
 	ObjLibrary::Vector2 lattice(int x, int y);
+	ObjLibrary::Vector2 gradient(unsigned int value);
 	/* member variables */
 	unsigned int seed[7];
 	float grid_size;
@@ -53,6 +53,9 @@ void PickupManager::draw()
 
 void PickupManager::update()
 {
+	m_moved_rings.clear();
+	m_ring_positions.clear();
+	m_ring_cursors.clear();
 	for (unsigned int i = 0; i < diskCount; i++) {
 		if (!m_ring[i].isPickedup()) {
 			bool update_succeed = m_ring[i].update(m_world, m_graph);
@@ -62,8 +65,21 @@ void PickupManager::update()
 				m_graph.updatePath(node_id);
 				m_ring[i].updatePath(m_world, m_graph);
 			}
+			m_moved_rings.push_back(i);
+			m_ring_positions.push_back(m_ring[i].getPosition());
+			m_ring_cursors.push_back(m_ring[i].getCursor());
 		}
 	}
+
+	// maintain disk height for all moved rings in one pass
+	m_ring_heights.resize(m_ring_positions.size());
+	if (!m_ring_positions.empty())
+		m_world.getHeights(m_ring_cursors.data(), m_ring_positions.data(),
+			m_ring_positions.size(), Ring::getRadius(), m_ring_heights.data());
+	for (unsigned int k = 0; k < m_moved_rings.size(); k++) {
+		m_ring[m_moved_rings[k]].setGroundHeight(m_ring_heights[k]);
+		m_ring[m_moved_rings[k]].getCursor() = m_ring_cursors[k];
+	}
 }
 
 int PickupManager::getScore()
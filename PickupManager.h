@@ -30,6 +30,12 @@ private:
 	World m_world;
 	MovementGraph m_graph;
 
+	// reused every update for the batched ring height query
+	std::vector<unsigned int> m_moved_rings;
+	std::vector<ObjLibrary::Vector3> m_ring_positions;
+	std::vector<World::Cursor> m_ring_cursors;
+	std::vector<float> m_ring_heights;
+
 	unsigned int diskCount;
 	unsigned int current_score;
 };
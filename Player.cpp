@@ -49,15 +49,25 @@ void Player::init(const World& world)
 
 void Player::update(const World& world)
 {	// Suggested Approach of jumping
-	const Disk& player_disk = world.getClosestDisk(m_position);
+	const Disk& player_disk = world.getClosestDisk(m_cursor, m_position);
 
 	Vector3 previous_position = m_position;
-	bool previous_on_disk = world.isCylinderOnAnyDisk(m_position, RADIUS);
+	bool previous_on_disk = world.isCylinderOnAnyDisk(m_cursor, m_position, RADIUS);
 
 	m_position += m_velocity * DeltaTime::FIXED_DELTA_TIME;
-	bool now_on_disk = world.isCylinderOnAnyDisk(m_position, RADIUS);
+	bool now_on_disk = world.isCylinderOnAnyDisk(m_cursor, m_position, RADIUS);
 
 	if (jumping) {// case 3 and 4
+		// a fast fall can pass through a ridge between two samples, so
+		// stop the step where the feet first meet the terrain
+		Vector3 step = m_position - previous_position;
+		if (step.y < 0.0) {
+			float hit = world.raycast(previous_position - Vector3(0.0, HALF_HEIGHT, 0.0), step, 1.0f);
+			if (hit >= 0.0f) {
+				m_position = previous_position + step * hit;
+				now_on_disk = world.isCylinderOnAnyDisk(m_cursor, m_position, RADIUS);
+			}
+		}
 		m_velocity += Vector3(0.0, -9.8, 0.0) * DeltaTime::FIXED_DELTA_TIME;
 		float surface = player_disk.getHeight(m_position);
 		if (m_position.y - HALF_HEIGHT <= surface + 0.01 && now_on_disk)
@@ -96,7 +106,7 @@ void Player::update(const World& world)
 
 void Player::updateY(const World& world)
 {
-	const Disk&  closest_disk = world.getClosestDisk(m_position);
+	const Disk&  closest_disk = world.getClosestDisk(m_cursor, m_position);
 
 	if(m_position.getDistanceXZ(closest_disk.getPosition()) <= RADIUS + closest_disk.getRadius())
 		m_position.y = closest_disk.getHeight(m_position) + HALF_HEIGHT;
@@ -137,28 +147,28 @@ void Player::isAttacked(ObjLibrary::Vector3 velocity)
 
 void Player::moveForward(const World& world)
 {
-	unsigned int disk_type = world.getClosestDisk(m_position).getDiskType();
+	unsigned int disk_type = world.getClosestDisk(m_cursor, m_position).getDiskType();
 	m_acceleration += m_forward * MOVE_RATE * DiskType::getAccelerationFactor(disk_type);
 	g_animation.markRunning(true);
 }
 
 void Player::moveBackward(const World& world)
 {
-	unsigned int disk_type = world.getClosestDisk(m_position).getDiskType();
+	unsigned int disk_type = world.getClosestDisk(m_cursor, m_position).getDiskType();
 	m_acceleration -= m_forward * MOVE_RATE * DiskType::getAccelerationFactor(disk_type);
 	g_animation.markRunning(false);
 }
 
 void Player::moveLeft(const World& world)
 {
-	unsigned int disk_type = world.getClosestDisk(m_position).getDiskType();
+	unsigned int disk_type = world.getClosestDisk(m_cursor, m_position).getDiskType();
 	m_acceleration += m_forward.getRotatedY(HALF_PI) * STRAFE_RATE 
 		* DiskType::getAccelerationFactor(disk_type);
 }
 
 void Player::moveRight(const World& world)
 {
-	unsigned int disk_type = world.getClosestDisk(m_position).getDiskType();
+	unsigned int disk_type = world.getClosestDisk(m_cursor, m_position).getDiskType();
 	m_acceleration -= m_forward.getRotatedY(HALF_PI) * STRAFE_RATE 
 		* DiskType::getAccelerationFactor(disk_type);
 }
@@ -208,27 +218,14 @@ void Player::slidingAcceleration(const Disk& player_disk)
 {
 	unsigned int disk_type = player_disk.getDiskType();
 
-	//compute minheight
-	double min_height = m_position.y;
-	Vector3 min_direction(0.0, 0.0, 0.0);
-	for (int i = 0; i < 60; i++) {
-		Vector3 direction = m_forward.getRotatedY(TWO_PI / 60.0 * (double)i);
-		Vector3 position = m_position + 0.01f * direction;
-		double height = player_disk.getHeight(position) + HALF_HEIGHT;
-		if (min_height > height) {
-			min_height = height;
-			min_direction = direction;
-		}
-	}
+	//the steepest way down is against the terrain gradient
+	Vector3 gradient = player_disk.getSlope(m_position);
+	float slope = (float)gradient.getNorm();
 
 	//compute sliding acceleration
-	float slope = 0.0f;
-	if (m_position.y > min_height)
-		slope = (float)(m_position.y - min_height) / 0.01f;
 	float min_slope = DiskType::getMinSlope(disk_type);
-	float acceleration = 0.0f;
-	if (slope > min_slope)
-		acceleration = 10.0f * (slope - min_slope);
-
-	m_velocity += min_direction * acceleration * DeltaTime::FIXED_DELTA_TIME;
+	if (slope > min_slope) {
+		float acceleration = 10.0f * (slope - min_slope);
+		m_velocity -= gradient / slope * acceleration * DeltaTime::FIXED_DELTA_TIME;
+	}
 }
\ No newline at end of file
@@ -42,6 +42,7 @@ private:
 	ObjLibrary::Vector3 m_forward;
 	ObjLibrary::Vector3 m_velocity; 
 	ObjLibrary::Vector3 m_acceleration;
+	World::Cursor m_cursor;
 
 	bool jumping;
 };
@@ -0,0 +1,53 @@
+//
+//	Random.h
+//
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+// SplitMix64: the n-th number of a stream is a hash of
+// seed + n * GAMMA, so every disk can have its own stream derived
+// from the world seed and its index, and the numbers are the same
+// on every platform and in any generation order
+class Random {
+public:
+	/* constructors and destructor */
+	explicit Random(uint64_t seed) : m_state(seed) {}
+
+	/* member functions */
+	uint64_t next64()
+	{
+		m_state += GAMMA;
+		return mix(m_state);
+	}
+	unsigned int next32() { return (unsigned int)(next64() >> 32); }
+	// 24 random bits, so the result is always below max
+	float nextInterval(float min, float max)
+	{
+		float random01 = (next64() >> 40) * (1.0f / 16777216.0f);
+		return random01 * (max - min) + min;
+	}
+	unsigned int nextInt(unsigned int count) { return next32() % count; }
+
+	// the seed of stream number index of a world
+	static uint64_t getStreamSeed(uint64_t world_seed, unsigned int index)
+	{
+		return mix(world_seed + GAMMA * ((uint64_t)index + 1));
+	}
+	static uint64_t mix(uint64_t z)
+	{
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+private:
+	static const uint64_t GAMMA = 0x9E3779B97F4A7C15ull;
+
+	/* member variables */
+	uint64_t m_state;
+};
+
+#endif
@@ -32,14 +32,27 @@ Ring::Ring()
 	, m_path()
 {}
 
-Ring::Ring(MovementGraph graph)
-	: angle(0.0f)
+Ring::Ring(const MovementGraph& graph)
+	: start_id()
+	, target_id()
+	, on_same_disk(true)
+	, angle(0.0f)
 	, pickup(false) 
 {
 	m_path = graph.getPath();
+	if (m_path.empty())
+		return;
 	start_id = m_path.top();
 	r_position = graph.getPosition(m_path.top());
 	m_path.pop();
+
+	// a ring with no goal waits at its start
+	if (m_path.empty()) {
+		target_id = start_id;
+		target = r_position;
+		on_same_disk = true;
+		return;
+	}
 	target_id = m_path.top();
 	target = graph.getPosition(m_path.top());
 	m_path.pop();
@@ -74,7 +87,7 @@ void Ring::drawPath(MovementGraph& graph) const
 	glEnd();
 	glLineWidth(1.0);
 
-	stack<unsigned int> copy_path = m_path;
+	MovementGraph::Path copy_path = m_path;
 	Vector3 current_node = target;
 	while (!copy_path.empty()) {
 		Vector3 next_node = graph.getPosition(copy_path.top());
@@ -108,15 +121,19 @@ bool Ring::update(const World& world, MovementGraph& graph)
 			moveInCircle(world, graph.getDiskId(start_id));
 		else
 			moveTowardsTarget(world);
-
-		// maintain disk height
-		r_position.y = HALF_HEIGHT + world.getHeight(r_position, RADIUS);
 	}
+	// the disk height is maintained by the caller in one batch
+	// for all rings, through setGroundHeight
 	return true;
 }
 
 void Ring::updatePath(const World& world, MovementGraph& graph)
 {
+	// no path was found, so stay put; the path is still empty, so
+	// the next update asks for another
+	if (graph.getPath().size() < 2)
+		return;
+
 	// update path, position, and target position
 	m_path = graph.getPath();
 	start_id = m_path.top();
@@ -132,9 +149,6 @@ void Ring::updatePath(const World& world, MovementGraph& graph)
 		moveInCircle(world, graph.getDiskId(start_id));
 	else
 		moveTowardsTarget(world);
-
-	// maintain disk height
-	r_position.y = HALF_HEIGHT + world.getHeight(r_position, RADIUS);
 }
 
 void Ring::pickingUp(Vector3 position, float radius, float half_height)
@@ -197,9 +211,29 @@ unsigned int Ring::getNodeId()
 	return target_id;
 }
 
+Vector3 Ring::getPosition() const
+{
+	return r_position;
+}
+
+void Ring::setGroundHeight(float height)
+{
+	r_position.y = HALF_HEIGHT + height;
+}
+
+World::Cursor& Ring::getCursor()
+{
+	return m_cursor;
+}
+
+float Ring::getRadius()
+{
+	return RADIUS;
+}
+
 void Ring::moveTowardsTarget(const World& world)
 {
-	unsigned int disk_type = world.getClosestDisk(r_position).getDiskType();
+	unsigned int disk_type = world.getClosestDisk(m_cursor, r_position).getDiskType();
 	float move_distance = SPEED * DiskType::getRingSpeedFactor(disk_type);
 	angle += ROTATION * DiskType::getRingSpeedFactor(disk_type);
 
@@ -218,7 +252,7 @@ void Ring::moveTowardsTarget(const World& world)
 void Ring::moveInCircle(const World& world, const unsigned int disk_id)
 {
 	// calculate the distance for 1 fame
-	const unsigned int disk_type = world.getClosestDisk(r_position).getDiskType();
+	const unsigned int disk_type = world.getClosestDisk(m_cursor, r_position).getDiskType();
 	const float move_distance = SPEED * DiskType::getRingSpeedFactor(disk_type);
 	angle += ROTATION * DiskType::getRingSpeedFactor(disk_type);
 
@@ -15,7 +15,7 @@ public:
 	
 	Ring();
 	~Ring() = default;
-	Ring(MovementGraph graph);
+	Ring(const MovementGraph& graph);
 
 	void draw();
 	//void drawLine();
@@ -26,6 +26,10 @@ public:
 	bool isPickedup();
 	unsigned int getPoint();
 	unsigned int getNodeId();
+	ObjLibrary::Vector3 getPosition() const;
+	void setGroundHeight(float height);
+	World::Cursor& getCursor();
+	static float getRadius();
 private:
 	void loadModel();
 	bool isModelsLoaded() const;
@@ -33,7 +37,7 @@ private:
 	void moveTowardsTarget(const World& world);
 	void moveInCircle(const World& world, const unsigned int disk_id);
 
-	std::stack<unsigned int> m_path;
+	MovementGraph::Path m_path;
 	unsigned int start_id;
 	unsigned int target_id;
 	bool on_same_disk;
@@ -43,6 +47,7 @@ private:
 
 	float angle;
 	bool pickup;
+	World::Cursor m_cursor;
 };
 
 #endif
\ No newline at end of file
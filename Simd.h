@@ -0,0 +1,15 @@
+//
+//	Simd.h
+//
+
+#ifndef SIMD_H
+#define SIMD_H
+
+// the vectorized kernels are compiled in when the compiler targets
+// AVX2 (/arch:AVX2 or -mavx2), otherwise the scalar loops are used
+#if defined(__AVX2__)
+#define USE_AVX2
+#include <immintrin.h>
+#endif
+
+#endif
@@ -0,0 +1,110 @@
+//
+//	TerrainPager.cpp
+//
+
+#include <algorithm>
+#include "TerrainPager.h"
+
+using namespace std;
+namespace {
+	// how often to look for heightmaps to evict, in frames
+	const unsigned int EVICT_INTERVAL = 30;
+	// a heightmap queried within this many frames is kept
+	const unsigned int EVICT_DELAY = 120;
+}
+
+TerrainPager::TerrainPager(unsigned int heightmap_count, size_t budget)
+	: m_budget(budget)
+	, m_frame(0)
+	, m_near_frame(heightmap_count, 0)
+	, m_requested(heightmap_count, false)
+	, m_stop(false)
+{
+	m_thread = thread(&TerrainPager::work, this);
+}
+
+// the queued heightmaps that were not built yet are dropped
+TerrainPager::~TerrainPager()
+{
+	{
+		lock_guard<mutex> lock(m_queue_mutex);
+		m_stop = true;
+	}
+	m_queue_ready.notify_one();
+	m_thread.join();
+}
+
+void TerrainPager::update(const vector<shared_ptr<Heightmap>>& heightmaps,
+	const vector<unsigned int>& near_heightmaps)
+{
+	m_frame++;
+	Heightmap::setFrame(m_frame);
+
+	bool is_queued = false;
+	{
+		lock_guard<mutex> lock(m_queue_mutex);
+		for (unsigned int k = 0; k < near_heightmaps.size(); k++) {
+			unsigned int i = near_heightmaps[k];
+			m_near_frame[i] = m_frame;
+			const shared_ptr<Heightmap>& heightmap = heightmaps[i];
+			if (!m_requested[i] && !heightmap->isResident()) {
+				m_requested[i] = true;
+				m_queue.push_back(heightmap);
+				is_queued = true;
+			}
+		}
+	}
+	if (is_queued)
+		m_queue_ready.notify_one();
+
+	if (m_frame % EVICT_INTERVAL == 0 && Heightmap::getResidentBytes() > m_budget)
+		evictOldest(heightmaps);
+}
+
+// this function evicts the least recently queried heightmaps, among
+// those away from every focus point, until the budget is met; a
+// heightmap shared by several disks is kept if any of them is near
+void TerrainPager::evictOldest(const vector<shared_ptr<Heightmap>>& heightmaps)
+{
+	vector<const Heightmap*> near_heightmaps;
+	for (unsigned int i = 0; i < heightmaps.size(); i++)
+		if (m_near_frame[i] == m_frame)
+			near_heightmaps.push_back(heightmaps[i].get());
+	sort(near_heightmaps.begin(), near_heightmaps.end());
+
+	vector<unsigned int> candidates;
+	for (unsigned int i = 0; i < heightmaps.size(); i++) {
+		const Heightmap& heightmap = *heightmaps[i];
+		if (heightmap.isResident() && heightmap.getLastUsed() + EVICT_DELAY <= m_frame &&
+			!binary_search(near_heightmaps.begin(), near_heightmaps.end(), &heightmap))
+			candidates.push_back(i);
+	}
+	sort(candidates.begin(), candidates.end(), [&heightmaps](unsigned int a, unsigned int b) {
+		unsigned int used_a = heightmaps[a]->getLastUsed();
+		unsigned int used_b = heightmaps[b]->getLastUsed();
+		return used_a < used_b || (used_a == used_b && a < b);
+	});
+
+	for (unsigned int k = 0; k < candidates.size() &&
+		Heightmap::getResidentBytes() > m_budget; k++)
+		heightmaps[candidates[k]]->evict();
+	for (unsigned int k = 0; k < candidates.size(); k++)
+		if (!heightmaps[candidates[k]]->isResident())
+			m_requested[candidates[k]] = false;
+}
+
+void TerrainPager::work()
+{
+	unique_lock<mutex> lock(m_queue_mutex);
+	while (true) {
+		m_queue_ready.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+		if (m_stop)
+			return;
+		shared_ptr<Heightmap> heightmap = m_queue.front();
+		m_queue.pop_front();
+
+		lock.unlock();
+		heightmap->makeResident();
+		lock.lock();
+	}
+}
@@ -0,0 +1,57 @@
+//
+//	TerrainPager.h
+//
+
+#ifndef TERRAINPAGER_H
+#define TERRAINPAGER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Heightmap.h"
+
+// keeps the heightmaps near the player resident: the ones coming
+// into range are built on a background thread, and once the
+// resident heights pass the memory budget the least recently used
+// ones are evicted; a heightmap that is queried while evicted is
+// rebuilt on the spot, so the budget only bounds the heightmaps
+// nothing has touched for a while; a heightmap is a whole disk's
+// terrain or one tile of a big disk
+class TerrainPager {
+public:
+	/* constructors and destructor */
+	TerrainPager(unsigned int heightmap_count, size_t budget);
+	~TerrainPager();
+	TerrainPager(const TerrainPager&) = delete;
+	TerrainPager& operator= (const TerrainPager&) = delete;
+
+	/* member functions */
+	size_t getBudget() const { return m_budget; }
+	void setBudget(size_t budget) { m_budget = budget; }
+	// called once a frame on the GL thread with the heightmaps that
+	// are within the resident radius of a focus point
+	void update(const std::vector<std::shared_ptr<Heightmap>>& heightmaps,
+		const std::vector<unsigned int>& near_heightmaps);
+
+private:
+	void evictOldest(const std::vector<std::shared_ptr<Heightmap>>& heightmaps);
+	void work();
+
+	/* member variables */
+	size_t m_budget;
+	unsigned int m_frame;
+	std::vector<unsigned int> m_near_frame;	// when each heightmap was last near a focus point
+	std::vector<bool> m_requested;		// queued since it was last evicted
+
+	// the background thread builds the heightmaps in m_queue
+	std::thread m_thread;
+	std::mutex m_queue_mutex;
+	std::condition_variable m_queue_ready;
+	std::deque<std::shared_ptr<Heightmap>> m_queue;
+	bool m_stop;
+};
+
+#endif
@@ -0,0 +1,74 @@
+//
+//	ThreadPool.cpp
+//
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(unsigned int thread_count)
+	: m_task(nullptr)
+	, m_count(0)
+	, m_next(0)
+	, m_busy(0)
+	, m_generation(0)
+	, m_stop(false)
+{
+	if (thread_count == 0)
+		thread_count = thread::hardware_concurrency();
+	for (unsigned int i = 1; i < thread_count; i++)
+		m_threads.push_back(thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_start.notify_all();
+	for (unsigned int i = 0; i < m_threads.size(); i++)
+		m_threads[i].join();
+}
+
+void ThreadPool::parallelFor(unsigned int count, const function<void(unsigned int)>& task)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_task = &task;
+		m_count = count;
+		m_next = 0;
+		m_busy = m_threads.size();
+		m_generation++;
+	}
+	m_start.notify_all();
+	runTasks();
+
+	unique_lock<mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_busy == 0; });
+	m_task = nullptr;
+}
+
+void ThreadPool::work()
+{
+	unsigned int generation = 0;
+	unique_lock<mutex> lock(m_mutex);
+	while (true) {
+		m_start.wait(lock, [&] { return m_stop || m_generation != generation; });
+		if (m_stop)
+			return;
+		generation = m_generation;
+
+		lock.unlock();
+		runTasks();
+		lock.lock();
+		if (--m_busy == 0)
+			m_done.notify_one();
+	}
+}
+
+void ThreadPool::runTasks()
+{
+	for (unsigned int i = m_next++; i < m_count; i = m_next++)
+		(*m_task)(i);
+}
@@ -0,0 +1,49 @@
+//
+//	ThreadPool.h
+//
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a fixed set of worker threads for splitting a loop across cores
+class ThreadPool {
+public:
+	/* constructors and destructor */
+	// thread_count includes the calling thread; 0 means one per core
+	explicit ThreadPool(unsigned int thread_count = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator= (const ThreadPool&) = delete;
+
+	/* member functions */
+	unsigned int getThreadCount() const { return m_threads.size() + 1; }
+	// calls task(i) for every i in [0, count) on the workers and the
+	// calling thread, handing out one index at a time, and returns
+	// when all calls have finished
+	void parallelFor(unsigned int count, const std::function<void(unsigned int)>& task);
+
+private:
+	void work();
+	void runTasks();
+
+	/* member variables */
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_done;
+	const std::function<void(unsigned int)>* m_task;
+	unsigned int m_count;
+	std::atomic<unsigned int> m_next;
+	unsigned int m_busy;		// workers still in the current loop
+	unsigned int m_generation;	// counts the loops started
+	bool m_stop;
+};
+
+#endif
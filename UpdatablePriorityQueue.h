@@ -574,7 +574,9 @@ public:
 	//  Precondition(s): N/A
 	//  Returns: N/A
 	//  Side Effect: All elements are removed from the queue for this
-	//               UpdatablePriorityQueue.
+	//               UpdatablePriorityQueue.  This takes time
+	//               proportional to the queue size, not the
+	//               capacity.
 	//
 	void clear();
 
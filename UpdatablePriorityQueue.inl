@@ -370,9 +370,10 @@ void UpdatablePriorityQueue<PriorityType> ::setMaximumQueueSize(unsigned int max
 template <typename PriorityType>
 void UpdatablePriorityQueue<PriorityType> ::clear()
 {
-	// clear the lookup array
-	for (unsigned int i = 0; i < m_capacity; i++)
-		md_lookup_indexes[i] = NOT_IN_QUEUE;
+	// clear the lookup array; only the enqueued elements
+	//  have lookup entries set
+	for (unsigned int i = 0; i < m_queue_size; i++)
+		md_lookup_indexes[md_queue_indexes[i]] = NOT_IN_QUEUE;
 
 	// queue contains logical garbage
 	m_queue_size = 0;
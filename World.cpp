@@ -2,64 +2,252 @@
 //	World.cpp
 //
 
+#include <algorithm>
 #include "World.h"
 #include "DiskType.h"
+#include "HeightmapPool.h"
+#include "Random.h"
+#include "ThreadPool.h"
 
 using namespace std;
 using namespace ObjLibrary;
+namespace {
+	// slack for rounding when deciding the grid search can stop
+	const double GRID_SEARCH_EPSILON = 1.0e-6;
+	// the largest query radius a cursor can answer from the
+	// neighbors of its disk; the entities use 0.25 to 0.7
+	const float CURSOR_MAX_RADIUS = 1.0f;
+	const double NEIGHBOR_SLACK = CURSOR_MAX_RADIUS + 0.01;
+	const unsigned int HEIGHT_CHUNK_SIZE = 64;
+	// the terrain kept around the player, unless setResidency is
+	// called; the heights of a grey rock disk take 25 KB
+	const float RESIDENT_RADIUS = 100.0f;
+	const size_t RESIDENT_BUDGET = 16 * 1024 * 1024;
+}
 
 //World::World() 
 	//: m_radius(0.0f) 
 	//, m_disks() {}
 
-// this function inputs a path of a file and stores information
-// (x, z, radius) for all disks and world radius
+// a new terrain every run, as the game always had
 void World::init(string file_name)
 {
-	ifstream in_data;	
-	in_data.open(file_name.c_str());
-	if (!in_data)
+	init(file_name, ((uint64_t)rand() << 32) ^ (uint64_t)rand());
+}
+
+// this function inputs a path of a file and stores information
+// (x, z, radius) for all disks and world radius; the file can be
+// either a "DISK version 1" text world or a binary world
+void World::init(string file_name, uint64_t seed)
+{
+	m_seed = seed;
+	if (WorldFile::isBinary(file_name))
 	{
-		// can't open file
-		exit(1);
+		// the disk table is read straight out of the mapped file
+		WorldFile world_file;
+		if (!world_file.open(file_name))
+			exit(1);
+		initDisks(world_file.getRadius(), world_file.getDisks(), world_file.getDiskCount(),
+			world_file.hasSeeds());
 	}
-
-	string firstline;	// get rid of the first line
-	getline(in_data, firstline);
-	if (firstline != "DISK version 1")
+	else
 	{
-		cerr << "Error in loadDisks: Invalid first line \"" << firstline << "\"" << endl;
-		exit(1);
+		float radius;
+		vector<WorldFile::DiskRecord> disks;
+		if (!WorldFile::readText(file_name, radius, disks))
+			exit(1);
+		initDisks(radius, disks.data(), disks.size(), false);
 	}
+}
 
-	in_data >> m_radius;	//get the world radius
-	if (m_radius <= 0.0f)
+// the terrain of a disk comes from its seed, which is taken from
+// the file if it has one and is otherwise the seed of stream i of
+// the world seed
+void World::initDisks(float radius, const WorldFile::DiskRecord disks[], unsigned int disk_count,
+	bool has_seeds)
+{
+	m_radius = radius;
+	m_pager.reset();
+	m_disks.clear();
+	m_disks.reserve(disk_count);
+	m_disk_arrays.clear();
+	// the disks hold on to the variants they use
+	unique_ptr<HeightmapPool> pool;
+	if (m_variant_count > 0)
+		pool.reset(new HeightmapPool(m_seed, m_variant_count));
+	for (unsigned int i = 0; i < disk_count; i++)
 	{
-		cerr << "Error in loadDisks: Non-positive world radius" << endl;
-		exit(1);
+		const WorldFile::DiskRecord& disk = disks[i];
+		uint64_t seed = has_seeds ? disk.seed : Random::getStreamSeed(m_seed, i);
+		m_disks.push_back({ Vector3(disk.x, 0.0, disk.z), disk.radius, seed, pool.get() });
+		m_disk_arrays.add(disk.x, disk.z, disk.radius, i);
 	}
+	m_grid.init(m_disks);
+	initNeighbors();
 
-	int disk_count;
-	in_data >> disk_count;		//get the number of disk
-	if (disk_count < 0)
-	{
-		cerr << "Error in loadDisks: Negative disk count" << endl;
-		exit(1);
+	m_draw_order.resize(disk_count);
+	for (unsigned int i = 0; i < disk_count; i++)
+		m_draw_order[i] = i;
+	stable_sort(m_draw_order.begin(), m_draw_order.end(),
+		[this](unsigned int a, unsigned int b) {
+			return m_disks[a].getDiskType() < m_disks[b].getDiskType();
+		});
+	m_tiles.clear();
+	m_tile_start.assign(1, 0);
+	for (unsigned int i = 0; i < disk_count; i++) {
+		for (unsigned int t = 0; t < m_disks[i].getTileCount(); t++)
+			m_tiles.push_back(m_disks[i].getTile(t));
+		m_tile_start.push_back(m_tiles.size());
 	}
+	m_resident_radius = RESIDENT_RADIUS;
+	m_pager = make_shared<TerrainPager>(m_tiles.size(), RESIDENT_BUDGET);
+}
 
-	for (int i = 0; i < disk_count; i++)
-	{
-		float x, z, radius;
-		in_data >> x >> z >> radius;
-		m_disks.push_back({ Vector3(x, 0.0, z), radius });
+// this function lists, for every disk, the disks that overlap it
+// once grown by NEIGHBOR_SLACK, using the grid to find candidates
+void World::initNeighbors()
+{
+	m_neighbor_start.assign(1, 0);
+	m_neighbors.clear();
+	vector<unsigned int> touching;
+	for (unsigned int i = 0; i < m_disks.size(); i++) {
+		findTouchingDisks(i, NEIGHBOR_SLACK, touching);
+		// a disk is its own neighbor
+		touching.insert(lower_bound(touching.begin(), touching.end(), i), i);
+
+		for (unsigned int k = 0; k < touching.size(); k++) {
+			const Disk& neighbor = m_disks[touching[k]];
+			m_neighbors.add(neighbor.getPosition().x, neighbor.getPosition().z,
+				neighbor.getRadius(), touching[k]);
+		}
+		m_neighbor_start.push_back(m_neighbors.getSize());
 	}
 }
 
-// this function displays all the disk from display list to screen
-void World::draw()
+// this function asks the grid for the disks near disk_index, so
+// it only tests the disks in the cells the grown disk overlaps
+void World::findTouchingDisks(unsigned int disk_index, double slack,
+	vector<unsigned int>& touching) const
+{
+	touching.clear();
+	if (m_grid.isEmpty())
+		return;
+	Vector3 position = m_disks[disk_index].getPosition();
+	double reach = m_disks[disk_index].getRadius() + slack;
+	int column0 = m_grid.getColumn(position.x - reach);
+	int column1 = m_grid.getColumn(position.x + reach);
+	int row0 = m_grid.getRow(position.z - reach);
+	int row1 = m_grid.getRow(position.z + reach);
+	for (int row = row0; row <= row1; row++)
+		m_grid.getDisks().findTouching(position.x, position.z, m_disks[disk_index].getRadius(),
+			m_grid.getCellBegin(column0, row), m_grid.getCellEnd(column1, row),
+			slack, touching);
+
+	// a disk spanning several cells is found more than once
+	sort(touching.begin(), touching.end());
+	touching.erase(unique(touching.begin(), touching.end()), touching.end());
+	touching.erase(remove(touching.begin(), touching.end(), disk_index), touching.end());
+}
+
+// a radius of 0 turns paging off, so every heightmap stays
+// resident once it is built
+void World::setResidency(float radius, size_t budget)
+{
+	m_resident_radius = radius;
+	if (radius <= 0.0f)
+		m_pager.reset();
+	else if (!m_pager)
+		m_pager = make_shared<TerrainPager>(m_tiles.size(), budget);
+	else
+		m_pager->setBudget(budget);
+}
+
+// this function finds the disks within the resident radius of any
+// focus point, and the tiles of theirs that are, and hands them to
+// the pager
+void World::updateResidency(const Vector3 focus[], unsigned int count)
+{
+	if (!m_pager)
+		return;
+
+	m_near_disks.clear();
+	if (!m_grid.isEmpty())
+		for (unsigned int f = 0; f < count; f++) {
+			Vector3 position = focus[f];
+			int column0 = m_grid.getColumn(position.x - m_resident_radius);
+			int column1 = m_grid.getColumn(position.x + m_resident_radius);
+			int row0 = m_grid.getRow(position.z - m_resident_radius);
+			int row1 = m_grid.getRow(position.z + m_resident_radius);
+			for (int row = row0; row <= row1; row++)
+				m_grid.getDisks().findTouching(position.x, position.z, 0.0f,
+					m_grid.getCellBegin(column0, row), m_grid.getCellEnd(column1, row),
+					m_resident_radius, m_near_disks);
+		}
+	sort(m_near_disks.begin(), m_near_disks.end());
+	m_near_disks.erase(unique(m_near_disks.begin(), m_near_disks.end()), m_near_disks.end());
+
+	m_near_tiles.clear();
+	vector<unsigned int> tiles;
+	for (unsigned int k = 0; k < m_near_disks.size(); k++) {
+		unsigned int i = m_near_disks[k];
+		tiles.clear();
+		for (unsigned int f = 0; f < count; f++)
+			m_disks[i].findTiles(focus[f], m_resident_radius, tiles);
+		for (unsigned int t = 0; t < tiles.size(); t++)
+			m_near_tiles.push_back(m_tile_start[i] + tiles[t]);
+	}
+	sort(m_near_tiles.begin(), m_near_tiles.end());
+	m_near_tiles.erase(unique(m_near_tiles.begin(), m_near_tiles.end()), m_near_tiles.end());
+	m_pager->update(m_tiles, m_near_tiles);
+}
+
+// each heightmap has its own random engine and is built under its
+// own lock, so the disks can be generated in any order on any thread
+bool World::buildTerrain(unsigned int thread_count)
+{
+	// with terrain variants many disks share a heightmap
+	vector<Heightmap*> heightmaps;
+	for (unsigned int i = 0; i < m_disks.size(); i++)
+		if (m_disks[i].getTileCount() == 1)
+			heightmaps.push_back(m_disks[i].getTile(0).get());
+	sort(heightmaps.begin(), heightmaps.end());
+	heightmaps.erase(unique(heightmaps.begin(), heightmaps.end()), heightmaps.end());
+
+	size_t total_bytes = 0;
+	for (unsigned int i = 0; i < heightmaps.size(); i++)
+		total_bytes += heightmaps[i]->getMemorySize();
+	if (m_pager && total_bytes > m_pager->getBudget())
+		return false;
+
+	ThreadPool pool(thread_count);
+	pool.parallelFor(heightmaps.size(), [&heightmaps](unsigned int i) {
+		heightmaps[i]->makeResident();
+	});
+	return true;
+}
+
+// this function displays all the disk from display list to screen;
+// with paging the pager builds the terrain near the player, and a
+// disk outside that range is drawn without it rather than stalling
+// the frame, otherwise each heightmap is built when first drawn;
+// the farther a disk is from the camera, the coarser its terrain;
+// the terrain is drawn one disk type at a time, so each texture
+// and index buffer is bound once per frame
+void World::draw(const Vector3& camera)
 {
 	for (unsigned int i = 0; i < m_disks.size(); i++)
-		m_disks[i].draw();
+		m_disks[i].drawModel();
+
+	unsigned int start = 0;
+	while (start < m_draw_order.size()) {
+		int type = m_disks[m_draw_order[start]].getDiskType();
+		Heightmap::beginDraw(type);
+		unsigned int end = start;
+		for (; end < m_draw_order.size() && m_disks[m_draw_order[end]].getDiskType() == type; end++)
+			m_disks[m_draw_order[end]].drawTerrain(!m_pager, camera);
+		Heightmap::endDraw();
+		start = end;
+	}
 }
 
 int World::getDiskCount() const
@@ -78,15 +266,18 @@ int World::getDiskNumber(ObjLibrary::Vector3 position, float radius) const
 {
 	float min_dist = m_radius;
 	int min_i = -1;
-	for (int i = 0; i < (int)m_disks.size(); i++) {
-		Vector3 d_position = m_disks[i].getPosition();
-		float d_radius = m_disks[i].getRadius();
-		float h_distance = (float)d_position.getDistanceXZ(position);
-		if (min_dist > h_distance && h_distance < d_radius + radius) {
-			min_dist = h_distance;
-			min_i = i;
-		}
-	}
+	if (m_grid.isEmpty())
+		return min_i;
+
+	// only disks whose bounding square meets the query square can
+	// be within d_radius + radius, and they are all in these cells
+	int column0 = m_grid.getColumn(position.x - radius);
+	int column1 = m_grid.getColumn(position.x + radius);
+	int row0 = m_grid.getRow(position.z - radius);
+	int row1 = m_grid.getRow(position.z + radius);
+	for (int row = row0; row <= row1; row++)
+		m_grid.getDisks().findNumber(m_grid.getCellBegin(column0, row), m_grid.getCellEnd(column1, row),
+			position.x, position.z, radius, min_i, min_dist);
 	return min_i;
 }
 
@@ -127,17 +318,104 @@ float World::getHeight(Vector3 position, float radius) const
 
 }
 
+// this function finds the disk under each position and hands every
+// run of positions on the same disk to that disk in one batch
+void World::getHeights(const Vector3 positions[], unsigned int count,
+	float radius, float heights[]) const
+{
+	int disk_numbers[HEIGHT_CHUNK_SIZE];
+	for (unsigned int start = 0; start < count; start += HEIGHT_CHUNK_SIZE) {
+		unsigned int chunk = min(HEIGHT_CHUNK_SIZE, count - start);
+		for (unsigned int i = 0; i < chunk; i++)
+			disk_numbers[i] = getDiskNumber(positions[start + i], radius);
+		getHeightsByDisk(positions + start, disk_numbers, chunk, heights + start);
+	}
+}
+
+// this function finds the disks the segment could pass over, with a
+// grid search around its bounding circle, and takes the first hit
+// among them; a disk spanning several of the cells is only tested
+// in the first of them that it is stored in, so nothing has to be
+// kept to skip the repeats
+float World::raycast(const Vector3& origin, const Vector3& direction, float max_t) const
+{
+	if (m_grid.isEmpty())
+		return -1.0f;
+
+	Vector3 end = origin + direction * max_t;
+	Vector3 middle = (origin + end) * 0.5;
+	float reach = (float)(origin.getDistanceXZ(end) * 0.5);
+	int column0 = m_grid.getColumn(middle.x - reach);
+	int column1 = m_grid.getColumn(middle.x + reach);
+	int row0 = m_grid.getRow(middle.z - reach);
+	int row1 = m_grid.getRow(middle.z + reach);
+	const DiskArrays& cell_disks = m_grid.getDisks();
+
+	float first_hit = -1.0f;
+	for (int row = row0; row <= row1; row++)
+		for (int column = column0; column <= column1; column++)
+			for (unsigned int slot = m_grid.getCellBegin(column, row);
+				slot < m_grid.getCellEnd(column, row); slot++) {
+				const Disk& disk = m_disks[cell_disks.getDiskIndex(slot)];
+				Vector3 position = disk.getPosition();
+				if (column != max(column0, m_grid.getColumn(position.x - disk.getRadius())) ||
+					row != max(row0, m_grid.getRow(position.z - disk.getRadius())))
+					continue;
+				if (position.getDistanceXZ(middle) > reach + disk.getRadius())
+					continue;
+				float hit = disk.raycast(origin, direction,
+					first_hit < 0.0f ? max_t : first_hit);
+				if (hit >= 0.0f && (first_hit < 0.0f || hit < first_hit))
+					first_hit = hit;
+			}
+	return first_hit;
+}
+
+// this function searches the grid in square rings around the
+// position until no unsearched cell can hold a closer disk
 unsigned int World::getClosestDiskIndex(const Vector3& position) const
 {
-	int best_disk = 0;
-	double best_distance = position.getDistanceXZ(m_disks[0].getPosition()) - m_disks[0].getRadius();
+	if (m_grid.isEmpty())
+		return 0;
 
-	for (int i = 1; i < (int)m_disks.size(); i++){
-		double distance = position.getDistanceXZ(m_disks[i].getPosition()) - m_disks[i].getRadius();
-		if (distance < best_distance){
-			best_disk = i;
-			best_distance = distance;
+	int column_count = m_grid.getColumnCount();
+	int row_count = m_grid.getRowCount();
+	int center_column = m_grid.getColumn(position.x);
+	int center_row = m_grid.getRow(position.z);
+	int best_disk = -1;
+	double best_distance = 0.0;
+
+	for (int ring = 0; ; ring++) {
+		int column0 = center_column - ring;
+		int column1 = center_column + ring;
+		int row0 = center_row - ring;
+		int row1 = center_row + ring;
+		for (int row = max(row0, 0); row <= min(row1, row_count - 1); row++) {
+			if (row == row0 || row == row1)
+				closestInCells(position, max(column0, 0), min(column1, column_count - 1),
+					row, best_disk, best_distance);
+			else {
+				if (column0 >= 0)
+					closestInCells(position, column0, column0, row, best_disk, best_distance);
+				if (column1 < column_count)
+					closestInCells(position, column1, column1, row, best_disk, best_distance);
+			}
 		}
+
+		// every disk not seen yet lies beyond the searched square
+		double bound = HUGE_VAL;
+		if (column0 > 0)
+			bound = min(bound, position.x - m_grid.getColumnMinX(column0));
+		if (column1 < column_count - 1)
+			bound = min(bound, m_grid.getColumnMinX(column1 + 1) - position.x);
+		if (row0 > 0)
+			bound = min(bound, position.z - m_grid.getRowMinZ(row0));
+		if (row1 < row_count - 1)
+			bound = min(bound, m_grid.getRowMinZ(row1 + 1) - position.z);
+		if (bound == HUGE_VAL)
+			break;
+		if (best_disk >= 0 && best_distance < bound - GRID_SEARCH_EPSILON)
+			break;
 	}
 
 	return best_disk;
@@ -152,4 +430,109 @@ bool World::isCylinderOnAnyDisk(const Vector3& position, float radius) const
 {
 	const Disk& closest_disk = getClosestDisk(position);
 	return position.getDistanceXZ(closest_disk.getPosition()) <= radius + closest_disk.getRadius();
+}
+
+// the cells from column0 to column1 of a row are one run of slots
+void World::closestInCells(const Vector3& position, int column0, int column1,
+	int row, int& best_disk, double& best_distance) const
+{
+	m_grid.getDisks().findClosest(m_grid.getCellBegin(column0, row), m_grid.getCellEnd(column1, row),
+		position.x, position.z, best_disk, best_distance);
+}
+
+// the cursor versions: when the position is still inside the
+// cursor's disk, every disk that could be the answer overlaps that
+// disk, so only its neighbor list has to be searched
+
+int World::getDiskNumber(Cursor& cursor, Vector3 position, float radius) const
+{
+	int index;
+	if (radius <= CURSOR_MAX_RADIUS && isInsideDisk(position, cursor.m_disk_index)) {
+		float min_dist = m_radius;
+		index = -1;
+		m_neighbors.findNumber(m_neighbor_start[cursor.m_disk_index],
+			m_neighbor_start[cursor.m_disk_index + 1],
+			position.x, position.z, radius, index, min_dist);
+	}
+	else
+		index = getDiskNumber(position, radius);
+
+	if (index >= 0)
+		cursor.m_disk_index = index;
+	return index;
+}
+
+float World::getHeight(Cursor& cursor, Vector3 position, float radius) const
+{
+	int index = getDiskNumber(cursor, position, radius);
+
+	if (index < 0)
+		return 0.0f;
+	else
+		return m_disks[index].getHeight(position);
+}
+
+void World::getHeights(Cursor cursors[], const Vector3 positions[],
+	unsigned int count, float radius, float heights[]) const
+{
+	int disk_numbers[HEIGHT_CHUNK_SIZE];
+	for (unsigned int start = 0; start < count; start += HEIGHT_CHUNK_SIZE) {
+		unsigned int chunk = min(HEIGHT_CHUNK_SIZE, count - start);
+		for (unsigned int i = 0; i < chunk; i++)
+			disk_numbers[i] = getDiskNumber(cursors[start + i], positions[start + i], radius);
+		getHeightsByDisk(positions + start, disk_numbers, chunk, heights + start);
+	}
+}
+
+unsigned int World::getClosestDiskIndex(Cursor& cursor, const Vector3& position) const
+{
+	if (isInsideDisk(position, cursor.m_disk_index)) {
+		int best_disk = -1;
+		double best_distance = 0.0;
+		m_neighbors.findClosest(m_neighbor_start[cursor.m_disk_index],
+			m_neighbor_start[cursor.m_disk_index + 1],
+			position.x, position.z, best_disk, best_distance);
+		cursor.m_disk_index = best_disk;
+	}
+	else
+		cursor.m_disk_index = getClosestDiskIndex(position);
+	return cursor.m_disk_index;
+}
+
+const Disk& World::getClosestDisk(Cursor& cursor, const Vector3& position) const
+{
+	return m_disks[getClosestDiskIndex(cursor, position)];
+}
+
+bool World::isCylinderOnAnyDisk(Cursor& cursor, const Vector3& position, float radius) const
+{
+	const Disk& closest_disk = getClosestDisk(cursor, position);
+	return position.getDistanceXZ(closest_disk.getPosition()) <= radius + closest_disk.getRadius();
+}
+
+bool World::isInsideDisk(const Vector3& position, int disk_index) const
+{
+	if (disk_index < 0 || disk_index >= (int)m_disks.size())
+		return false;
+	const Disk& disk = m_disks[disk_index];
+	return position.getDistanceXZ(disk.getPosition()) <= disk.getRadius();
+}
+
+// hands every run of positions on the same disk to that disk
+void World::getHeightsByDisk(const Vector3 positions[], const int disk_numbers[],
+	unsigned int count, float heights[]) const
+{
+	unsigned int start = 0;
+	while (start < count) {
+		int index = disk_numbers[start];
+		unsigned int end = start + 1;
+		while (end < count && disk_numbers[end] == index)
+			end++;
+
+		if (index < 0)
+			fill(heights + start, heights + end, 0.0f);
+		else
+			m_disks[index].getHeights(positions + start, end - start, heights + start);
+		start = end;
+	}
 }
\ No newline at end of file
@@ -6,18 +6,39 @@
 #define WORLD_H
 
 #include <fstream>
+#include <memory>
 #include <vector>
 #include "Disk.h"
+#include "DiskArrays.h"
+#include "DiskGrid.h"
+#include "TerrainPager.h"
+#include "WorldFile.h"
 
 class World {
 public:
+	// remembers the disk an entity was last found on, so that the
+	// next lookup can check that disk and its overlapping neighbors
+	// before falling back to a search of the whole world
+	class Cursor {
+	public:
+		Cursor() : m_disk_index(-1) {}
+	private:
+		friend class World;
+		int m_disk_index;
+	};
+
 	/* constructors and destructor */
 	//World();
 	//~World() = default;
 
 	/* member functions */
 	void init(std::string file_name);	// initial the world class from file
-	void draw();					// display all disks
+	void init(std::string file_name, uint64_t seed);	// ... with the terrain from seed
+	uint64_t getSeed() const { return m_seed; }
+	// opt-in, before init: the disks of each type share this many
+	// heightmaps instead of each having its own (0, the default)
+	void setTerrainVariants(unsigned int count) { m_variant_count = count; }
+	void draw(const ObjLibrary::Vector3& camera);	// display all disks
 	int getDiskCount() const;
 	float getRadius() const;
 	int getDiskNumber(ObjLibrary::Vector3 position, float radius) const;
@@ -25,14 +46,75 @@ public:
 	const Disk& getDisk(int disk_number) const;
 	bool isOnDisk(ObjLibrary::Vector3 position, float radius) const;
 	float getHeight(ObjLibrary::Vector3 position, float radius) const;
+	void getHeights(const ObjLibrary::Vector3 positions[], unsigned int count,
+		float radius, float heights[]) const;
 	unsigned int getClosestDiskIndex(const ObjLibrary::Vector3& position) const;
 	const Disk& getClosestDisk(const ObjLibrary::Vector3& position) const;
 	bool isCylinderOnAnyDisk(const ObjLibrary::Vector3& position, float radius) const;
+	const DiskArrays& getDiskArrays() const { return m_disk_arrays; }
+	// the disks, in index order and without disk_index itself, that
+	// overlap disk disk_index once it is grown by slack
+	void findTouchingDisks(unsigned int disk_index, double slack,
+		std::vector<unsigned int>& touching) const;
+	// the first t in [0, max_t] at which origin + t * direction is
+	// below the terrain of any disk, or -1 if there is none; for
+	// landing and line of sight tests over a whole step
+	float raycast(const ObjLibrary::Vector3& origin, const ObjLibrary::Vector3& direction,
+		float max_t) const;
+
+	// terrain residency: the heightmaps within radius of a focus
+	// point are kept resident and the rest are evicted when over
+	// budget bytes (a radius of 0 turns this off); updateResidency
+	// must be called on the GL thread
+	void setResidency(float radius, size_t budget);
+	void updateResidency(const ObjLibrary::Vector3 focus[], unsigned int count);
+	// build every heightmap now, on all cores, if the whole terrain
+	// fits in the budget; the display lists are still compiled on
+	// the GL thread when the disks are drawn; the tiles of big disks
+	// are left to be built when they are needed
+	bool buildTerrain(unsigned int thread_count = 0);
+
+	// the same queries, starting from an entity's cursor
+	int getDiskNumber(Cursor& cursor, ObjLibrary::Vector3 position, float radius) const;
+	float getHeight(Cursor& cursor, ObjLibrary::Vector3 position, float radius) const;
+	void getHeights(Cursor cursors[], const ObjLibrary::Vector3 positions[],
+		unsigned int count, float radius, float heights[]) const;
+	unsigned int getClosestDiskIndex(Cursor& cursor, const ObjLibrary::Vector3& position) const;
+	const Disk& getClosestDisk(Cursor& cursor, const ObjLibrary::Vector3& position) const;
+	bool isCylinderOnAnyDisk(Cursor& cursor, const ObjLibrary::Vector3& position, float radius) const;
 
 private: 
+	void initDisks(float radius, const WorldFile::DiskRecord disks[], unsigned int disk_count,
+		bool has_seeds);
+	void initNeighbors();
+	bool isInsideDisk(const ObjLibrary::Vector3& position, int disk_index) const;
+	void getHeightsByDisk(const ObjLibrary::Vector3 positions[], const int disk_numbers[],
+		unsigned int count, float heights[]) const;
+	void closestInCells(const ObjLibrary::Vector3& position, int column0, int column1,
+		int row, int& best_disk, double& best_distance) const;
 	/* member variables */
 	float m_radius;
+	uint64_t m_seed;
+	unsigned int m_variant_count = 0;
 	std::vector<Disk> m_disks;
+	// the disk indexes sorted by disk type, for drawing
+	std::vector<unsigned int> m_draw_order;
+	DiskArrays m_disk_arrays;
+	DiskGrid m_grid;
+	// every disk within CURSOR_MAX_RADIUS of overlapping disk i
+	// (itself included) is in slots m_neighbor_start[i] to
+	// m_neighbor_start[i + 1] - 1 of m_neighbors
+	std::vector<unsigned int> m_neighbor_start;
+	DiskArrays m_neighbors;
+	// copies of the world share the heightmaps, and so the pager
+	float m_resident_radius;
+	std::shared_ptr<TerrainPager> m_pager;
+	std::vector<unsigned int> m_near_disks;
+	// the heightmaps of every disk, for the pager: disk i has the
+	// ones in slots m_tile_start[i] to m_tile_start[i + 1] - 1
+	std::vector<std::shared_ptr<Heightmap>> m_tiles;
+	std::vector<unsigned int> m_tile_start;
+	std::vector<unsigned int> m_near_tiles;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,245 @@
+//
+//	WorldFile.cpp
+//
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "WorldFile.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+namespace {
+	const char MAGIC[4] = { 'D', 'S', 'K', 'B' };
+}
+
+WorldFile::WorldFile()
+	: m_data(nullptr)
+	, m_size(0)
+#ifdef _WIN32
+	, m_file(INVALID_HANDLE_VALUE)
+	, m_mapping(NULL)
+#else
+	, m_file(-1)
+#endif
+{
+	static_assert(sizeof(Header) == 32, "WorldFile header must be 32 bytes");
+	static_assert(sizeof(DiskRecord) == 16, "WorldFile disk record must be 16 bytes");
+}
+
+WorldFile::~WorldFile()
+{
+	close();
+}
+
+// this function maps the whole file read-only and checks that the
+// header and table fit in it
+bool WorldFile::open(const string& file_name)
+{
+	close();
+
+#ifdef _WIN32
+	m_file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		cerr << "Error in WorldFile: Cannot open \"" << file_name << "\"" << endl;
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(m_file, &file_size)) {
+		cerr << "Error in WorldFile: Cannot get the size of \"" << file_name << "\"" << endl;
+		close();
+		return false;
+	}
+	m_size = (size_t)file_size.QuadPart;
+	if (m_size >= sizeof(Header)) {
+		m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_mapping != NULL)
+			m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	m_file = ::open(file_name.c_str(), O_RDONLY);
+	if (m_file < 0) {
+		cerr << "Error in WorldFile: Cannot open \"" << file_name << "\"" << endl;
+		return false;
+	}
+	struct stat file_stat;
+	if (fstat(m_file, &file_stat) != 0) {
+		cerr << "Error in WorldFile: Cannot get the size of \"" << file_name << "\"" << endl;
+		close();
+		return false;
+	}
+	m_size = (size_t)file_stat.st_size;
+	if (m_size >= sizeof(Header)) {
+		void* data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+		if (data != MAP_FAILED)
+			m_data = (const char*)data;
+	}
+#endif
+
+	if (m_data == nullptr) {
+		cerr << "Error in WorldFile: Cannot map \"" << file_name << "\"" << endl;
+		close();
+		return false;
+	}
+	if (memcmp(getHeader()->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		getHeader()->version != VERSION) {
+		cerr << "Error in WorldFile: \"" << file_name << "\" is not a version "
+			<< VERSION << " binary world" << endl;
+		close();
+		return false;
+	}
+	if (!(getHeader()->radius > 0.0f)) {
+		cerr << "Error in WorldFile: Non-positive world radius" << endl;
+		close();
+		return false;
+	}
+	if ((m_size - sizeof(Header)) / sizeof(DiskRecord) < getHeader()->disk_count) {
+		cerr << "Error in WorldFile: \"" << file_name << "\" is truncated" << endl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+void WorldFile::close()
+{
+#ifdef _WIN32
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != NULL)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_mapping = NULL;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_data != nullptr)
+		munmap((void*)m_data, m_size);
+	if (m_file >= 0)
+		::close(m_file);
+	m_file = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
+
+float WorldFile::getRadius() const
+{
+	assert(isOpen());
+	return getHeader()->radius;
+}
+
+unsigned int WorldFile::getDiskCount() const
+{
+	assert(isOpen());
+	return getHeader()->disk_count;
+}
+
+bool WorldFile::hasSeeds() const
+{
+	assert(isOpen());
+	return (getHeader()->flags & HAS_SEEDS) != 0;
+}
+
+const WorldFile::DiskRecord* WorldFile::getDisks() const
+{
+	assert(isOpen());
+	return (const DiskRecord*)(m_data + sizeof(Header));
+}
+
+bool WorldFile::isBinary(const string& file_name)
+{
+	ifstream in_data(file_name.c_str(), ios::binary);
+	char magic[sizeof(MAGIC)];
+	if (!in_data.read(magic, sizeof(magic)))
+		return false;
+	return memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+// this function reads the text format one value at a time, the way
+// World::init always has
+bool WorldFile::readText(const string& file_name, float& radius, vector<DiskRecord>& disks)
+{
+	ifstream in_data;
+	in_data.open(file_name.c_str());
+	if (!in_data)
+	{
+		cerr << "Error in loadDisks: Cannot open \"" << file_name << "\"" << endl;
+		return false;
+	}
+
+	string firstline;	// get rid of the first line
+	getline(in_data, firstline);
+	if (!firstline.empty() && firstline.back() == '\r')
+		firstline.pop_back();
+	if (firstline != "DISK version 1")
+	{
+		cerr << "Error in loadDisks: Invalid first line \"" << firstline << "\"" << endl;
+		return false;
+	}
+
+	in_data >> radius;	//get the world radius
+	if (radius <= 0.0f)
+	{
+		cerr << "Error in loadDisks: Non-positive world radius" << endl;
+		return false;
+	}
+
+	int disk_count;
+	in_data >> disk_count;		//get the number of disk
+	if (disk_count < 0)
+	{
+		cerr << "Error in loadDisks: Negative disk count" << endl;
+		return false;
+	}
+
+	disks.clear();
+	disks.reserve(disk_count);
+	for (int i = 0; i < disk_count; i++)
+	{
+		DiskRecord disk = {};
+		in_data >> disk.x >> disk.z >> disk.radius;
+		disks.push_back(disk);
+	}
+	return true;
+}
+
+bool WorldFile::write(const string& file_name, float radius,
+	const vector<DiskRecord>& disks, unsigned int flags)
+{
+	Header header = {};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.flags = flags;
+	header.disk_count = (unsigned int)disks.size();
+	header.radius = radius;
+
+	ofstream out_data(file_name.c_str(), ios::binary);
+	out_data.write((const char*)&header, sizeof(header));
+	if (!disks.empty())
+		out_data.write((const char*)disks.data(), disks.size() * sizeof(DiskRecord));
+	if (!out_data) {
+		cerr << "Error in WorldFile: Cannot write \"" << file_name << "\"" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool WorldFile::convert(const string& text_name, const string& binary_name)
+{
+	float radius;
+	vector<DiskRecord> disks;
+	if (!readText(text_name, radius, disks))
+		return false;
+	return write(binary_name, radius, disks, 0);
+}
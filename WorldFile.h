@@ -0,0 +1,82 @@
+//
+//	WorldFile.h
+//
+
+#ifndef WORLDFILE_H
+#define WORLDFILE_H
+
+#include <string>
+#include <vector>
+
+// the binary world format: a fixed header followed by a flat
+// table of disk records, all little-endian.  The file is mapped
+// into memory and the table is read in place, without copying.
+//
+//	offset	size	field
+//	0	4	magic "DSKB"
+//	4	4	version (1)
+//	8	4	flags (HAS_SEEDS)
+//	12	4	disk count
+//	16	4	world radius (float)
+//	20	12	reserved, 0
+//	32	16 * disk count	disk records
+class WorldFile {
+public:
+	struct DiskRecord {
+		float x;
+		float z;
+		float radius;
+		unsigned int seed;	// only meaningful with HAS_SEEDS
+	};
+
+	static const unsigned int VERSION = 1;
+	static const unsigned int HAS_SEEDS = 0x1;
+
+	/* constructors and destructor */
+	WorldFile();
+	~WorldFile();
+	WorldFile(const WorldFile&) = delete;
+	WorldFile& operator= (const WorldFile&) = delete;
+
+	/* member functions */
+	bool open(const std::string& file_name);	// map the file, false on error
+	void close();
+	bool isOpen() const { return m_data != nullptr; }
+	float getRadius() const;
+	unsigned int getDiskCount() const;
+	bool hasSeeds() const;
+	const DiskRecord* getDisks() const;
+
+	// whether a file starts with the binary magic
+	static bool isBinary(const std::string& file_name);
+	// read a "DISK version 1" text world
+	static bool readText(const std::string& file_name, float& radius,
+		std::vector<DiskRecord>& disks);
+	static bool write(const std::string& file_name, float radius,
+		const std::vector<DiskRecord>& disks, unsigned int flags);
+	// convert a text world to the binary format
+	static bool convert(const std::string& text_name, const std::string& binary_name);
+
+private:
+	struct Header {
+		char magic[4];
+		unsigned int version;
+		unsigned int flags;
+		unsigned int disk_count;
+		float radius;
+		unsigned int reserved[3];
+	};
+	const Header* getHeader() const { return (const Header*)m_data; }
+
+	/* member variables */
+	const char* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_file;
+#endif
+};
+
+#endif